@@ -0,0 +1,718 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// End to end benchmark of the isolator.
+//
+// Loads DockerVolumeDriverIsolator directly, without an agent, times
+// recover() of a large generated legacy mount list, then runs prepare()
+// followed by cleanup() for many synthetic containers. Volumes are
+// served by a stub dvdcli script, the fake backend or a fake volume
+// plugin on a Unix socket, all of which only create directories, so the
+// numbers are the isolator's own overhead plus the configured backend
+// latency. With the plugin, VolumePluginClient is first checked against
+// it call by call, error responses included.
+//
+// Must run as root, like the isolator itself. Everything is kept under
+// --work_dir, the agent's own module state is never touched.
+
+#include <sys/mount.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+#include <mesos/slave/isolator.hpp>
+
+#include <process/collect.hpp>
+#include <process/future.hpp>
+#include <process/owned.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/json.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/result.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include <slave/state.hpp>
+
+#include "docker_volume_driver_isolator.hpp"
+#include "fake_volume_plugin.hpp"
+#include "volume_plugin.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::list;
+using std::string;
+using std::vector;
+
+using process::Future;
+using process::Owned;
+
+using namespace mesos;
+using namespace mesos::slave;
+
+static constexpr char USAGE[] =
+  "Usage: dvdi-benchmark [--option=value ...]\n"
+  "\n"
+  "  --operations=N       containers prepared and cleaned up (1000)\n"
+  "  --concurrency=N      containers in flight at once (32)\n"
+  "  --volumes=N          volumes per container (1)\n"
+  "  --shared_ratio=R     share of volumes drawn from a common pool,\n"
+  "                       from 0 to 1 (0.2)\n"
+  "  --shared_volumes=N   size of the common pool (8)\n"
+  "  --latency=D          backend latency per call, e.g. 20ms (0ms)\n"
+  "  --backend=B          dvdcli (stub script), fake or plugin (fake\n"
+  "                       plugin, ignores --latency) (dvdcli)\n"
+  "  --driver_limits=S    driver_concurrency_limits of the module,\n"
+  "                       e.g. *=4 (none)\n"
+  "  --recover_mounts=N   mounts in the generated legacy mount list,\n"
+  "                       0 skips the recover() benchmark (10000)\n"
+  "  --work_dir=DIR       scratch directory (/tmp/dvdi-benchmark)\n";
+
+struct Options
+{
+  size_t operations = 1000;
+  size_t concurrency = 32;
+  size_t volumes = 1;
+  double sharedRatio = 0.2;
+  size_t sharedVolumes = 8;
+  Duration latency = Duration::zero();
+  string backend = DVDI_BACKEND_DVDCLI;
+  string driverLimits;
+  size_t recoverMounts = 10000;
+  string workDir = "/tmp/dvdi-benchmark";
+};
+
+
+// Latencies of one kind of call, in milliseconds.
+class Samples
+{
+public:
+  void add(const Duration& duration)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    values.push_back(duration.ms());
+  }
+
+  void report(const string& name, const Duration& elapsed)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::sort(values.begin(), values.end());
+
+    cout << std::left << std::setw(10) << name << std::right << std::fixed
+         << std::setprecision(1)
+         << std::setw(10) << values.size() / elapsed.secs() << " ops/s"
+         << "  p50 " << std::setw(8) << percentile(0.5)
+         << "  p90 " << std::setw(8) << percentile(0.9)
+         << "  p99 " << std::setw(8) << percentile(0.99)
+         << "  p999 " << std::setw(8) << percentile(0.999)
+         << "  max " << std::setw(8) << percentile(1) << " ms"
+         << endl;
+  }
+
+private:
+  double percentile(double p) const
+  {
+    if (values.empty()) {
+      return 0;
+    }
+    const size_t index = std::min(
+        values.size() - 1,
+        static_cast<size_t>(p * values.size()));
+    return values[index];
+  }
+
+  std::mutex mutex;
+  vector<double> values;
+};
+
+
+static Try<Options> parse(int argc, char** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; i++) {
+    const string arg = argv[i];
+    const size_t separator = arg.find('=');
+    if (!strings::startsWith(arg, "--") || separator == string::npos) {
+      return Error("Unknown argument " + arg);
+    }
+
+    const string key = arg.substr(2, separator - 2);
+    const string value = arg.substr(separator + 1);
+
+    Try<size_t> number = numify<size_t>(value);
+
+    if (key == "operations" && number.isSome()) {
+      options.operations = number.get();
+    } else if (key == "concurrency" && number.isSome() && number.get() > 0) {
+      options.concurrency = number.get();
+    } else if (key == "volumes" && number.isSome() && number.get() > 0) {
+      options.volumes = number.get();
+    } else if (key == "shared_ratio" && numify<double>(value).isSome()) {
+      options.sharedRatio = numify<double>(value).get();
+    } else if (key == "shared_volumes" && number.isSome() &&
+               number.get() > 0) {
+      options.sharedVolumes = number.get();
+    } else if (key == "latency" && Duration::parse(value).isSome()) {
+      options.latency = Duration::parse(value).get();
+    } else if (key == "backend" &&
+               (value == DVDI_BACKEND_DVDCLI || value == DVDI_BACKEND_FAKE ||
+                value == DVDI_BACKEND_PLUGIN)) {
+      options.backend = value;
+    } else if (key == "driver_limits" && parseDriverLimits(value).isSome()) {
+      options.driverLimits = value;
+    } else if (key == "recover_mounts" && number.isSome()) {
+      options.recoverMounts = number.get();
+    } else if (key == "work_dir" && value.length() > 1 &&
+               strings::startsWith(value, "/")) {
+      options.workDir = value;
+    } else {
+      return Error("Invalid argument " + arg);
+    }
+  }
+
+  return options;
+}
+
+
+// Writes a dvdcli stand-in that sleeps for the latency and, on mount,
+// creates and prints <root>/<driver>/<volume>.
+static Try<string> writeStub(const Options& options)
+{
+  const string stub = path::join(options.workDir, "dvdcli");
+  const string root = path::join(options.workDir, "mounts");
+
+  std::ostringstream script;
+  script << "#!/bin/sh\n"
+         << "command=$1\n"
+         << "shift\n"
+         << "for arg; do\n"
+         << "  case $arg in\n"
+         << "    --volumename=*) name=${arg#--volumename=} ;;\n"
+         << "    --volumedriver=*) driver=${arg#--volumedriver=} ;;\n"
+         << "  esac\n"
+         << "done\n";
+
+  if (options.latency > Duration::zero()) {
+    script << "sleep " << options.latency.secs() << "\n";
+  }
+
+  script << "if [ \"$command\" = mount ]; then\n"
+         << "  mkdir -p " << root << "/$driver/$name\n"
+         << "  echo " << root << "/$driver/$name\n"
+         << "fi\n";
+
+  Try<Nothing> write = os::write(stub, script.str());
+  if (write.isError()) {
+    return Error("Failed to write " + stub + ": " + write.error());
+  }
+
+  Try<Nothing> chmod = os::chmod(stub, 0755);
+  if (chmod.isError()) {
+    return Error("Failed to make " + stub + " executable: " + chmod.error());
+  }
+
+  return stub;
+}
+
+
+// A tmpfs mounted over the directory the volumes of the "bench" driver
+// are created in, for as long as it lives. The isolator checks that a
+// volume is mounted at its mountpoint or that mountpoint's parent, as
+// REX-Ray's are.
+class ScratchMount
+{
+public:
+  explicit ScratchMount(const string& _target) : target(_target) {}
+
+  ~ScratchMount()
+  {
+    if (mounted) {
+      ::umount2(target.c_str(), MNT_DETACH);
+    }
+  }
+
+  Try<Nothing> mount()
+  {
+    Try<Nothing> mkdir = os::mkdir(target);
+    if (mkdir.isError()) {
+      return Error("Failed to create " + target + ": " + mkdir.error());
+    }
+
+    if (::mount("dvdi-benchmark", target.c_str(), "tmpfs", 0, NULL) != 0) {
+      return ErrnoError("Failed to mount a tmpfs at " + target);
+    }
+
+    mounted = true;
+    return Nothing();
+  }
+
+private:
+  const string target;
+  bool mounted = false;
+};
+
+
+static Try<Isolator*> createIsolator(
+    const Options& options,
+    const string& stateDir)
+{
+  Parameters parameters;
+
+  auto add = [&parameters](const string& key, const string& value) {
+    Parameter* parameter = parameters.add_parameter();
+    parameter->set_key(key);
+    parameter->set_value(value);
+  };
+
+  add(DVDI_STATEDIR_PARAM_NAME, stateDir);
+  add(DVDI_BACKEND_PARAM_NAME, options.backend);
+  add(DVDI_PLUGINDIR_PARAM_NAME, path::join(options.workDir, "plugins"));
+  add(DVDI_FAKEDIR_PARAM_NAME, path::join(options.workDir, "mounts"));
+  add(DVDI_FAKELATENCY_PARAM_NAME, stringify(options.latency));
+  if (!options.driverLimits.empty()) {
+    add(DVDI_DRIVERLIMITS_PARAM_NAME, options.driverLimits);
+  }
+
+  return DockerVolumeDriverIsolator::create(parameters);
+}
+
+
+// Environment of container `index`: each volume comes from the shared
+// pool with probability shared_ratio, otherwise it is the container's
+// own.
+static ExecutorInfo executorInfo(
+    const Options& options,
+    const string& stub,
+    size_t index)
+{
+  ExecutorInfo executor;
+  executor.mutable_executor_id()->set_value("bench");
+  executor.mutable_command()->set_value("true");
+
+  Environment* environment =
+    executor.mutable_command()->mutable_environment();
+
+  auto set = [environment](const string& name, const string& value) {
+    Environment::Variable* variable = environment->add_variables();
+    variable->set_name(name);
+    variable->set_value(value);
+  };
+
+  for (size_t i = 0; i < options.volumes; i++) {
+    const string suffix = i == 0 ? "" : stringify(i);
+
+    // Deterministic, so every run of a configuration does the same work.
+    const size_t draw = (index * 7919 + i * 104729) % 1000;
+    const string volume = draw < options.sharedRatio * 1000
+      ? "shared" + stringify(draw % options.sharedVolumes)
+      : "volume" + stringify(index) + "x" + stringify(i);
+
+    set(string(VOL_NAME_ENV_VAR_NAME) + suffix, volume);
+    set(string(VOL_DRIVER_ENV_VAR_NAME) + suffix, "bench");
+    set(string(VOL_DVDCLI_ENV_VAR_NAME) + suffix, stub);
+  }
+
+  return executor;
+}
+
+
+static Future<Nothing> prepare(
+    Isolator* isolator,
+    const ContainerID& containerId,
+    const ExecutorInfo& executor,
+    const string& directory)
+{
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+  return isolator->prepare(containerId, executor, directory, None(), None())
+    .then([]() { return Nothing(); });
+#elif MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 270
+  return isolator->prepare(containerId, executor, directory, None())
+    .then([]() { return Nothing(); });
+#else
+  ContainerConfig config;
+#if MESOS_VERSION_INT < 200 || MESOS_VERSION_INT >= 280
+  config.mutable_executor_info()->CopyFrom(executor);
+#else
+  config.mutable_executorinfo()->CopyFrom(executor);
+#endif
+  config.set_directory(directory);
+
+  return isolator->prepare(containerId, config)
+    .then([]() { return Nothing(); });
+#endif
+}
+
+
+// Runs containers first, first + step, ... one after the other.
+static Future<Nothing> worker(
+    Isolator* isolator,
+    const Options& options,
+    const string& stub,
+    size_t index,
+    Samples* prepares,
+    Samples* cleanups,
+    std::atomic<size_t>* failures)
+{
+  if (index >= options.operations) {
+    return Nothing();
+  }
+
+  ContainerID containerId;
+  containerId.set_value("bench-" + stringify(index));
+
+  const string directory =
+    path::join(options.workDir, "sandboxes", containerId.value());
+  os::mkdir(directory);
+
+  Stopwatch prepareWatch;
+  prepareWatch.start();
+
+  return prepare(
+      isolator, containerId, executorInfo(options, stub, index), directory)
+    .then([=]() {
+      prepares->add(prepareWatch.elapsed());
+
+      Stopwatch cleanupWatch;
+      cleanupWatch.start();
+
+      return isolator->cleanup(containerId)
+        .then([=]() {
+          cleanups->add(cleanupWatch.elapsed());
+          return Nothing();
+        });
+    })
+    .repair([=](const Future<Nothing>& result) {
+      cerr << "Container " << containerId.value() << " failed: "
+           << result.failure() << endl;
+      ++*failures;
+      return Nothing();
+    })
+    .then([=]() {
+      return worker(
+          isolator,
+          options,
+          stub,
+          index + options.concurrency,
+          prepares,
+          cleanups,
+          failures);
+    });
+}
+
+
+// Writes a legacy mount list of recover_mounts volumes into stateDir.
+// Every mount belongs to a container that is gone, so recover() parses
+// the whole list and unmounts every volume.
+static Try<Nothing> writeMountList(
+    const Options& options,
+    const string& stub,
+    const string& stateDir)
+{
+  ExternalMountList mounts;
+  for (size_t i = 0; i < options.recoverMounts; i++) {
+    Owned<ExternalMount> mount(
+      Builder().setContainerId("gone-" + stringify(i))
+               .setVolumeDriver("bench")
+               .setVolumeName("recover" + stringify(i))
+               .setDvdcliPath(stub)
+               .setBackend(options.backend)
+               .setExplicitCreate(false)
+               .build());
+    mounts.add_mount()->CopyFrom(*mount);
+  }
+
+  const string mountlist = path::join(stateDir, DVDI_MOUNTLIST_FILENAME);
+  Try<Nothing> checkpoint =
+    mesos::internal::slave::state::checkpoint(mountlist, mounts);
+  if (checkpoint.isError()) {
+    return Error("Failed to write " + mountlist + ": " + checkpoint.error());
+  }
+
+  return Nothing();
+}
+
+
+// Waits for a call of the plugin check, noting it in errors unless it
+// succeeded in time.
+template <typename T>
+static bool ready(
+    const string& call,
+    Future<T> future,
+    const Duration& timeout,
+    list<string>* errors)
+{
+  if (!future.await(timeout)) {
+    future.discard();
+    errors->push_back(call + " timed out after " + stringify(timeout));
+    return false;
+  }
+
+  if (!future.isReady()) {
+    errors->push_back(call + " failed: " +
+                      (future.isFailed() ? future.failure() : "discarded"));
+    return false;
+  }
+
+  return true;
+}
+
+
+// Drives VolumePluginClient through every call against the fake plugin,
+// then checks that both ways a plugin reports an error fail the call.
+static int checkPlugin(const Options& options, FakeVolumePlugin* plugin)
+{
+  const VolumePluginClient client(path::join(options.workDir, "plugins"));
+
+  auto volume = [](const string& name) {
+    return Owned<ExternalMount>(
+      Builder().setContainerId("check")
+               .setVolumeDriver("bench")
+               .setVolumeName(name)
+               .setBackend(DVDI_BACKEND_PLUGIN)
+               .setExplicitCreate(true)
+               .build());
+  };
+
+  const Duration timeout = Seconds(10);
+  const string expected =
+    path::join(options.workDir, "mounts", "bench", "checked");
+  Owned<ExternalMount> checked = volume("checked");
+
+  list<string> errors;
+
+  Future<string> mountpoint = client.mount(*checked);
+  if (ready("Mount", mountpoint, timeout, &errors) &&
+      (mountpoint.get() != expected || plugin->mounted("checked") != 1)) {
+    errors.push_back("Mount returned " + mountpoint.get() + ", expected " +
+                     expected + " mounted once");
+  }
+
+  Future<string> found = client.path(*checked);
+  if (ready("Path", found, timeout, &errors) && found.get() != expected) {
+    errors.push_back("Path returned " + found.get() + ", expected " + expected);
+  }
+
+  Future<JSON::Object> get = client.get(*checked);
+  if (ready("Get", get, timeout, &errors)) {
+    Result<JSON::String> name = get.get().find<JSON::String>("Name");
+    if (!name.isSome() || name.get().value != "checked") {
+      errors.push_back("Get returned " + stringify(get.get()));
+    }
+  }
+
+  Future<Nothing> unmount = client.unmount(*checked);
+  if (ready("Unmount", unmount, timeout, &errors) &&
+      plugin->mounted("checked") != 0) {
+    errors.push_back("Unmount left the volume mounted");
+  }
+
+  const string broken = string(FAKE_PLUGIN_ERR_PREFIX) + "volume";
+  mountpoint = client.mount(*volume(broken));
+  mountpoint.await(timeout);
+  if (!mountpoint.isFailed() ||
+      !strings::contains(mountpoint.failure(), broken + " is broken")) {
+    errors.push_back("Mount did not fail with the plugin's Err");
+  }
+
+  const string crashed = string(FAKE_PLUGIN_STATUS_PREFIX) + "volume";
+  Future<Nothing> create = client.create(*volume(crashed));
+  create.await(timeout);
+  if (!create.isFailed() ||
+      !strings::contains(create.failure(), "status 500")) {
+    errors.push_back("Create did not fail with the plugin's status 500");
+  }
+
+  foreach (const string& error, errors) {
+    cerr << "Plugin check: " << error << endl;
+  }
+
+  if (!errors.empty()) {
+    return 1;
+  }
+
+  cout << "VolumePluginClient checked against the fake plugin" << endl;
+  return 0;
+}
+
+
+static int benchmarkRecover(const Options& options, Isolator* isolator)
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+  Future<Nothing> recovered =
+    isolator->recover(list<ExecutorRunState>(), hashset<ContainerID>());
+#else
+  Future<Nothing> recovered =
+    isolator->recover(list<ContainerState>(), hashset<ContainerID>());
+#endif
+
+  recovered.await();
+
+  const Duration elapsed = stopwatch.elapsed();
+  if (!recovered.isReady()) {
+    cerr << "recover() failed: "
+         << (recovered.isFailed() ? recovered.failure() : "discarded")
+         << endl;
+    return 1;
+  }
+
+  cout << "recover() of " << options.recoverMounts << " orphaned mounts took "
+       << elapsed << " ("
+       << std::fixed << std::setprecision(1)
+       << options.recoverMounts / elapsed.secs()
+       << " mounts/s)" << endl;
+
+  return 0;
+}
+
+
+static int benchmarkPrepareCleanup(
+    const Options& options,
+    const string& stub,
+    Isolator* isolator)
+{
+  Samples prepares;
+  Samples cleanups;
+  std::atomic<size_t> failures(0);
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  list<Future<Nothing>> workers;
+  for (size_t i = 0; i < options.concurrency; i++) {
+    workers.push_back(worker(
+        isolator, options, stub, i, &prepares, &cleanups, &failures));
+  }
+
+  process::collect(workers).await();
+
+  const Duration elapsed = stopwatch.elapsed();
+
+  cout << options.operations << " containers with " << options.volumes
+       << " volumes each in " << elapsed << ", " << failures.load()
+       << " failed"
+       << endl;
+  prepares.report("prepare", elapsed);
+  cleanups.report("cleanup", elapsed);
+
+  return failures == 0 ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+  Try<Options> options = parse(argc, argv);
+  if (options.isError()) {
+    cerr << options.error() << endl << endl << USAGE;
+    return 1;
+  }
+
+  const string volumes = path::join(options.get().workDir, "mounts", "bench");
+
+  // Left behind by a run that did not get to unmount it.
+  ::umount2(volumes.c_str(), MNT_DETACH);
+  os::rmdir(options.get().workDir);
+
+  Try<Nothing> mkdir = os::mkdir(options.get().workDir);
+  if (mkdir.isError()) {
+    cerr << "Failed to create " << options.get().workDir << ": "
+         << mkdir.error() << endl;
+    return 1;
+  }
+
+  Try<string> stub = writeStub(options.get());
+  if (stub.isError()) {
+    cerr << stub.error() << endl;
+    return 1;
+  }
+
+  ScratchMount scratch(volumes);
+  Try<Nothing> mounted = scratch.mount();
+  if (mounted.isError()) {
+    cerr << mounted.error() << endl;
+    return 1;
+  }
+
+  // Serves the "bench" driver at plugin_socket_dir/bench.sock, mounting
+  // volumes where the stub and the fake backend create them.
+  FakeVolumePlugin plugin(
+      path::join(options.get().workDir, "plugins", "bench.sock"), volumes);
+  if (options.get().backend == DVDI_BACKEND_PLUGIN) {
+    Try<Nothing> started = plugin.start();
+    if (started.isError()) {
+      cerr << "Failed to start the fake plugin: " << started.error() << endl;
+      return 1;
+    }
+  }
+
+  const string stateDir = path::join(options.get().workDir, "state");
+  os::mkdir(stateDir);
+
+  if (options.get().recoverMounts > 0) {
+    Try<Nothing> written =
+      writeMountList(options.get(), stub.get(), stateDir);
+    if (written.isError()) {
+      cerr << written.error() << endl;
+      return 1;
+    }
+  }
+
+  // A single isolator serves both phases, as on an agent: destroying
+  // it shuts the protobuf library down for good.
+  Try<Isolator*> isolator = createIsolator(options.get(), stateDir);
+  if (isolator.isError()) {
+    cerr << "Failed to create the isolator: " << isolator.error() << endl;
+    return 1;
+  }
+
+  Owned<Isolator> owned(isolator.get());
+
+  int status = 0;
+  if (options.get().backend == DVDI_BACKEND_PLUGIN) {
+    // Creating the isolator initialized libprocess, which the client's
+    // I/O runs on.
+    status |= checkPlugin(options.get(), &plugin);
+  }
+
+  if (options.get().recoverMounts > 0) {
+    status |= benchmarkRecover(options.get(), owned.get());
+  }
+
+  status |= benchmarkPrepareCleanup(options.get(), stub.get(), owned.get());
+
+  return status;
+}
@@ -0,0 +1,402 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmarks of the isolator's bookkeeping, the parts whose cost
+// grows with the number of mounts on the agent.
+//
+// Each benchmark runs at 10, 100, 1000 and 10000 tracked mounts, and
+// the harness repeats it until it has run for --min_time. Benchmarks
+// follow the Google Benchmark layout, so they can move there unchanged
+// should the project take it on as a dependency: the body prepares its
+// data, then loops `while (state.keepRunning())` over the timed part.
+//
+// A per operation time that grows with the number of mounts where it
+// should not is the regression to look for.
+
+#include <string.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <mesos/mesos.hpp>
+
+#include <process/owned.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/json.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "docker_volume_driver_isolator.hpp"
+#include "mount_table.hpp"
+#include "volume_backend.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+using process::Owned;
+
+using namespace mesos;
+using namespace mesos::slave;
+
+static constexpr char USAGE[] =
+  "Usage: dvdi-microbenchmark [--option=value ...]\n"
+  "\n"
+  "  --filter=S     only run benchmarks whose name contains S\n"
+  "  --min_time=D   how long to repeat each benchmark, e.g. 1secs (500ms)\n";
+
+static const size_t RANGES[] = {10, 100, 1000, 10000};
+
+
+class State
+{
+public:
+  State(size_t _range, size_t _iterations)
+    : range(_range), iterations(_iterations), remaining(_iterations) {}
+
+  // Starts the clock on the first call, stops it once all iterations
+  // have run.
+  bool keepRunning()
+  {
+    if (remaining == iterations) {
+      stopwatch.start();
+    }
+    if (remaining == 0) {
+      stopwatch.stop();
+      return false;
+    }
+    --remaining;
+    return true;
+  }
+
+  Duration elapsed() const { return stopwatch.elapsed(); }
+
+  // Number of mounts the benchmark runs against.
+  const size_t range;
+  const size_t iterations;
+
+private:
+  size_t remaining;
+  Stopwatch stopwatch;
+};
+
+
+// Keeps the compiler from optimizing away a result that is never used.
+template <typename T>
+static void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+using Benchmark = void (*)(State&);
+
+static vector<std::pair<string, Benchmark>>& benchmarks()
+{
+  static vector<std::pair<string, Benchmark>> registered;
+  return registered;
+}
+
+struct Registration
+{
+  Registration(const char* name, Benchmark benchmark)
+  {
+    benchmarks().push_back(std::make_pair(string(name), benchmark));
+  }
+};
+
+#define BENCHMARK(name)                                    \
+  static void name(State& state);                          \
+  static Registration name##_registration(#name, name);    \
+  static void name(State& state)
+
+
+// Mounts of distinct volumes, one per container, as prepare() builds
+// them.
+static vector<Owned<ExternalMount>> makeMounts(size_t count)
+{
+  vector<Owned<ExternalMount>> mounts;
+  for (size_t i = 0; i < count; i++) {
+    mounts.push_back(Owned<ExternalMount>(Builder()
+      .setContainerId("container-" + stringify(i))
+      .setVolumeDriver("rexray")
+      .setVolumeName("volume-" + stringify(i))
+      .setMountPoint("/var/lib/rexray/volumes/volume-" + stringify(i))
+      .setOptions("size=5,iops=150,volumetype=io1")
+      .setContainerPath("/data")
+      .setDvdcliPath(DEFAULT_DVDCLI_BIN)
+      .setExplicitCreate(false)
+      .setBackend(DVDI_BACKEND_DVDCLI)
+      .build()));
+  }
+  return mounts;
+}
+
+static ContainerID containerId(const ExternalMount& em)
+{
+  ContainerID id;
+  id.set_value(em.containerid());
+  return id;
+}
+
+// A table of `count` containers, half of them sharing their volume with
+// another container, as on an agent running replicated tasks.
+static MountTable makeTable(const vector<Owned<ExternalMount>>& mounts)
+{
+  MountTable table;
+  for (size_t i = 0; i < mounts.size(); i++) {
+    table.track(containerId(*mounts[i]), mounts[i / 2 * 2]);
+  }
+  return table;
+}
+
+
+// Keys of all mounts. Expected to be linear in the number of mounts.
+BENCHMARK(MountKey)
+{
+  const vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+
+  while (state.keepRunning()) {
+    foreach (const Owned<ExternalMount>& mount, mounts) {
+      doNotOptimize(mountKey(*mount));
+    }
+  }
+}
+
+// Keys of all mounts read back from a legacy checkpoint, which lack the
+// cached key.
+BENCHMARK(MountKeyUncached)
+{
+  vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+  foreach (const Owned<ExternalMount>& mount, mounts) {
+    mount->clear_volume_key();
+  }
+
+  while (state.keepRunning()) {
+    foreach (const Owned<ExternalMount>& mount, mounts) {
+      doNotOptimize(mountKey(*mount));
+    }
+  }
+}
+
+// The in-use and refcount checks prepare() makes for one volume.
+// Expected to be constant.
+BENCHMARK(MountTableLookup)
+{
+  const vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+  const MountTable table = makeTable(mounts);
+  const string key = mountKey(*mounts[state.range / 2]);
+
+  while (state.keepRunning()) {
+    doNotOptimize(table.inUse(key));
+    doNotOptimize(table.refcount(key));
+    doNotOptimize(table.mountpoint(key));
+  }
+}
+
+// A container joining a shared volume in prepare(), then leaving it in
+// cleanup(). Expected to be constant.
+BENCHMARK(MountTableTrackUntrack)
+{
+  const vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+  MountTable table = makeTable(mounts);
+
+  ContainerID id;
+  id.set_value("benchmark");
+  const Owned<ExternalMount> shared = mounts[state.range / 2];
+
+  while (state.keepRunning()) {
+    table.track(id, shared);
+    doNotOptimize(table.untrack(id));
+  }
+}
+
+// Building and serializing the ExternalMountList of a journal snapshot.
+// Expected to be linear in the number of mounts.
+BENCHMARK(SerializeMountList)
+{
+  const vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+  const MountTable table = makeTable(mounts);
+
+  while (state.keepRunning()) {
+    ExternalMountList list;
+    foreachvalue (const Owned<ExternalMount>& mount, table.all()) {
+      list.add_mount()->CopyFrom(*mount);
+    }
+    string data;
+    list.SerializeToString(&data);
+    doNotOptimize(data);
+  }
+}
+
+// Parsing a serialized ExternalMountList, as recover() does.
+BENCHMARK(ParseMountList)
+{
+  const vector<Owned<ExternalMount>> mounts = makeMounts(state.range);
+
+  ExternalMountList list;
+  foreach (const Owned<ExternalMount>& mount, mounts) {
+    list.add_mount()->CopyFrom(*mount);
+  }
+  string data;
+  list.SerializeToString(&data);
+
+  while (state.keepRunning()) {
+    ExternalMountList parsed;
+    doNotOptimize(parsed.ParseFromString(data));
+  }
+}
+
+// Converting a volume's options into dvdcli arguments, with one option
+// per mount. Expected to be linear in the number of options.
+BENCHMARK(FormatOptions)
+{
+  vector<string> options;
+  for (size_t i = 0; i < state.range; i++) {
+    options.push_back("option" + stringify(i) + "=" + stringify(i));
+  }
+  const string joined = strings::join(",", options);
+
+  while (state.keepRunning()) {
+    doNotOptimize(formatOptions(joined));
+  }
+}
+
+// Parsing the environment of a task with one volume per mount, each
+// with a name and a container path, as prepare() does for every
+// container. Expected to be linear in the number of volumes.
+BENCHMARK(ParseVolumeSpecs)
+{
+  Environment environment;
+  for (size_t i = 0; i < state.range; i++) {
+    Environment_Variable* name = environment.add_variables();
+    name->set_name(VOL_NAME_ENV_VAR_NAME + stringify(i));
+    name->set_value("volume-" + stringify(i));
+
+    Environment_Variable* containerPath = environment.add_variables();
+    containerPath->set_name(VOL_CPATH_ENV_VAR_NAME + stringify(i));
+    containerPath->set_value("/data/" + stringify(i));
+  }
+
+  while (state.keepRunning()) {
+    doNotOptimize(DockerVolumeDriverIsolator::parseVolumeSpecs(environment));
+  }
+}
+
+// The same volumes listed in DVDI_VOLUMES.
+BENCHMARK(ParseVolumesJson)
+{
+  JSON::Array volumes;
+  for (size_t i = 0; i < state.range; i++) {
+    JSON::Object volume;
+    volume.values["name"] = JSON::String("volume-" + stringify(i));
+    volume.values["containerpath"] = JSON::String("/data/" + stringify(i));
+    volumes.values.push_back(volume);
+  }
+
+  Environment environment;
+  Environment_Variable* variable = environment.add_variables();
+  variable->set_name(VOLS_ENV_VAR_NAME);
+  variable->set_value(stringify(volumes));
+
+  while (state.keepRunning()) {
+    doNotOptimize(DockerVolumeDriverIsolator::parseVolumeSpecs(environment));
+  }
+}
+
+
+// Runs the benchmark with growing iteration counts until one run takes
+// at least minTime, then reports that run.
+static void run(
+    const string& name,
+    Benchmark benchmark,
+    size_t range,
+    const Duration& minTime)
+{
+  size_t iterations = 1;
+
+  while (true) {
+    State state(range, iterations);
+    benchmark(state);
+
+    const Duration elapsed = state.elapsed();
+    if (elapsed >= minTime || iterations >= 1000000000) {
+      cout << std::left << std::setw(32) << (name + "/" + stringify(range))
+           << std::right << std::setw(14) << iterations << " iterations"
+           << std::fixed << std::setprecision(1) << std::setw(16)
+           << elapsed.ns() / iterations << " ns/op" << endl;
+      return;
+    }
+
+    // Aim just past minTime from what this run took.
+    const double factor = elapsed.ns() > 0
+      ? 1.4 * minTime.ns() / elapsed.ns()
+      : 10;
+    iterations = std::max(
+        iterations + 1,
+        static_cast<size_t>(iterations * std::min(factor, 10.0)));
+  }
+}
+
+
+int main(int argc, char** argv)
+{
+  string filter;
+  Duration minTime = Milliseconds(500);
+
+  for (int i = 1; i < argc; i++) {
+    const string arg = argv[i];
+    if (strings::startsWith(arg, "--filter=")) {
+      filter = arg.substr(strlen("--filter="));
+    } else if (strings::startsWith(arg, "--min_time=") &&
+               Duration::parse(arg.substr(strlen("--min_time="))).isSome()) {
+      minTime = Duration::parse(arg.substr(strlen("--min_time="))).get();
+    } else {
+      cerr << "Invalid argument " << arg << endl << endl << USAGE;
+      return 1;
+    }
+  }
+
+  // parseVolumeSpecs() logs every variable it accepts, which would be all
+  // that gets measured.
+  FLAGS_minloglevel = google::WARNING;
+
+  for (size_t i = 0; i < benchmarks().size(); i++) {
+    const string& name = benchmarks()[i].first;
+    if (!filter.empty() && !strings::contains(name, filter)) {
+      continue;
+    }
+
+    foreach (size_t range, RANGES) {
+      run(name, benchmarks()[i].second, range, minTime);
+    }
+  }
+
+  return 0;
+}
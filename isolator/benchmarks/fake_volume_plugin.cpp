@@ -0,0 +1,269 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/result.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "fake_volume_plugin.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace slave {
+
+// Reads one request off the connection: headers, then Content-Length
+// bytes of body. Returns false if the client went away first.
+static bool readRequest(int fd, string* headers, string* body)
+{
+  string data;
+  char buffer[4096];
+
+  size_t headersEnd;
+  while ((headersEnd = data.find("\r\n\r\n")) == string::npos) {
+    const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return false;
+    }
+    data.append(buffer, length);
+  }
+
+  *headers = data.substr(0, headersEnd);
+  *body = data.substr(headersEnd + 4);
+
+  size_t contentLength = 0;
+  foreach (const string& line, strings::split(*headers, "\r\n")) {
+    if (strings::startsWith(strings::lower(line), "content-length:")) {
+      Try<size_t> parsed = numify<size_t>(
+          strings::trim(line.substr(strlen("content-length:"))));
+      if (parsed.isSome()) {
+        contentLength = parsed.get();
+      }
+    }
+  }
+
+  while (body->size() < contentLength) {
+    const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return false;
+    }
+    body->append(buffer, length);
+  }
+
+  return true;
+}
+
+static void writeAll(int fd, const string& data)
+{
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t length =
+      ::write(fd, data.data() + written, data.size() - written);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return;
+    }
+    written += length;
+  }
+}
+
+static string response(const string& status, const JSON::Object& object)
+{
+  const string body = stringify(object);
+
+  std::ostringstream out;
+  out << "HTTP/1.0 " << status << "\r\n"
+      << "Content-Type: application/vnd.docker.plugins.v1.2+json\r\n"
+      << "Content-Length: " << body.size() << "\r\n"
+      << "\r\n"
+      << body;
+  return out.str();
+}
+
+
+FakeVolumePlugin::FakeVolumePlugin(const string& _socket, const string& _root)
+  : socket(_socket), root(_root), fd(-1) {}
+
+FakeVolumePlugin::~FakeVolumePlugin()
+{
+  if (fd >= 0) {
+    // Wakes the accept() of the serving thread.
+    ::shutdown(fd, SHUT_RDWR);
+    thread.join();
+    os::close(fd);
+    os::rm(socket);
+  }
+}
+
+Try<Nothing> FakeVolumePlugin::start()
+{
+  struct sockaddr_un address;
+  if (socket.size() >= sizeof(address.sun_path)) {
+    return Error("Plugin socket path " + socket + " is too long");
+  }
+
+  Try<Nothing> mkdir = os::mkdir(Path(socket).dirname());
+  if (mkdir.isError()) {
+    return Error("Failed to create the socket directory: " + mkdir.error());
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket.c_str(), sizeof(address.sun_path) - 1);
+
+  const int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (s < 0) {
+    return ErrnoError("Failed to create a socket");
+  }
+
+  os::rm(socket);
+  if (::bind(s, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+      ::listen(s, SOMAXCONN) != 0) {
+    ErrnoError error("Failed to listen on " + socket);
+    os::close(s);
+    return error;
+  }
+
+  fd = s;
+  thread = std::thread([this]() { serve(); });
+
+  return Nothing();
+}
+
+size_t FakeVolumePlugin::mounted(const string& volumename)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return mounts.get(volumename).getOrElse(0);
+}
+
+void FakeVolumePlugin::serve()
+{
+  while (true) {
+    const int connection = ::accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return; // Shut down.
+    }
+
+    string headers;
+    string body;
+    if (readRequest(connection, &headers, &body)) {
+      // "POST /VolumeDriver.Mount HTTP/1.0"
+      const std::vector<string> request = strings::tokenize(
+          headers.substr(0, headers.find("\r\n")), " ");
+      const string method = request.size() > 1 ? request[1] : "";
+
+      writeAll(connection, respond(method, body));
+    }
+
+    os::close(connection);
+  }
+}
+
+string FakeVolumePlugin::respond(const string& method, const string& body)
+{
+  JSON::Object result;
+
+  Try<JSON::Object> request = JSON::parse<JSON::Object>(body);
+  if (request.isError()) {
+    result.values["Err"] = JSON::String("Malformed request body");
+    return response("400 Bad Request", result);
+  }
+
+  Result<JSON::String> name = request.get().find<JSON::String>("Name");
+  if (!name.isSome() || name.get().value.empty()) {
+    result.values["Err"] = JSON::String("Missing volume name");
+    return response("400 Bad Request", result);
+  }
+
+  const string volumename = name.get().value;
+
+  if (strings::startsWith(volumename, FAKE_PLUGIN_STATUS_PREFIX)) {
+    return response("500 Internal Server Error", result);
+  }
+
+  if (strings::startsWith(volumename, FAKE_PLUGIN_ERR_PREFIX)) {
+    result.values["Err"] = JSON::String("Volume " + volumename + " is broken");
+    return response("200 OK", result);
+  }
+
+  const string mountpoint = path::join(root, volumename);
+
+  if (method == "/VolumeDriver.Create") {
+    // Nothing to create.
+  } else if (method == "/VolumeDriver.Mount") {
+    Try<Nothing> mkdir = os::mkdir(mountpoint);
+    if (mkdir.isError()) {
+      result.values["Err"] = JSON::String(mkdir.error());
+      return response("200 OK", result);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    mounts[volumename]++;
+    result.values["Mountpoint"] = JSON::String(mountpoint);
+  } else if (method == "/VolumeDriver.Unmount") {
+    // Unmounting a volume that is not mounted succeeds, as with REX-Ray,
+    // so the orphans of the recover() benchmark unmount cleanly.
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mounts.contains(volumename) && --mounts[volumename] == 0) {
+      mounts.erase(volumename);
+    }
+  } else if (method == "/VolumeDriver.Path") {
+    std::lock_guard<std::mutex> lock(mutex);
+    result.values["Mountpoint"] =
+      JSON::String(mounts.contains(volumename) ? mountpoint : "");
+  } else if (method == "/VolumeDriver.Get") {
+    JSON::Object volume;
+    volume.values["Name"] = JSON::String(volumename);
+    volume.values["Mountpoint"] = JSON::String(mountpoint);
+    result.values["Volume"] = volume;
+  } else {
+    result.values["Err"] = JSON::String("Unknown method " + method);
+    return response("404 Not Found", result);
+  }
+
+  result.values["Err"] = JSON::String("");
+  return response("200 OK", result);
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,79 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_FAKE_VOLUME_PLUGIN_HPP_
+#define SRC_FAKE_VOLUME_PLUGIN_HPP_
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <stout/hashmap.hpp>
+#include <stout/json.hpp>
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace slave {
+
+// Volumes whose name starts with this get an "Err" in the response
+// body, as a plugin reports a failed call.
+static constexpr char FAKE_PLUGIN_ERR_PREFIX[]    = "err-";
+
+// Volumes whose name starts with this get a bare HTTP 500, as a plugin
+// that crashed mid call.
+static constexpr char FAKE_PLUGIN_STATUS_PREFIX[] = "status-";
+
+// A Docker volume plugin serving a Unix socket, for exercising
+// VolumePluginClient without any storage. Mounting a volume creates
+// <root>/<volumename> and returns it as the mountpoint.
+//
+// Serves one connection at a time on a thread of its own, with plain
+// blocking I/O so it does not share libprocess with the client.
+class FakeVolumePlugin
+{
+public:
+  FakeVolumePlugin(const std::string& socket, const std::string& root);
+
+  ~FakeVolumePlugin();
+
+  Try<Nothing> start();
+
+  // Mounts of the volume not unmounted yet.
+  size_t mounted(const std::string& volumename);
+
+private:
+  void serve();
+
+  // Handles one request, returns the HTTP response to send.
+  std::string respond(const std::string& method, const std::string& body);
+
+  const std::string socket;
+  const std::string root;
+
+  int fd;
+  std::thread thread;
+
+  std::mutex mutex;
+  hashmap<std::string, size_t> mounts;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_FAKE_VOLUME_PLUGIN_HPP_ */
@@ -0,0 +1,86 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/strings.hpp>
+
+#include "admission_queue.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace slave {
+
+Try<hashmap<string, size_t>> parseDriverLimits(const string& value)
+{
+  hashmap<string, size_t> limits;
+
+  foreach (const string& entry, strings::tokenize(value, ",")) {
+    const size_t separator = entry.find('=');
+    if (separator == string::npos) {
+      return Error("Expected volumedriver=limit, not '" + entry + "'");
+    }
+
+    const string volumedriver = strings::trim(entry.substr(0, separator));
+    if (volumedriver.empty()) {
+      return Error("Missing volume driver in '" + entry + "'");
+    }
+
+    Try<size_t> limit =
+      numify<size_t>(strings::trim(entry.substr(separator + 1)));
+    if (limit.isError() || limit.get() == 0) {
+      return Error("Limit of " + volumedriver + " must be a positive integer");
+    }
+
+    limits[volumedriver] = limit.get();
+  }
+
+  return limits;
+}
+
+
+AdmissionQueue::AdmissionQueue(
+    size_t agentLimit,
+    const hashmap<string, size_t>& driverLimits)
+  : agent(new ConcurrencyLimiter(agentLimit)),
+    limits(driverLimits) {}
+
+std::shared_ptr<ConcurrencyLimiter> AdmissionQueue::driver(
+    const string& volumedriver)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (!drivers.contains(volumedriver)) {
+    if (limits.contains(volumedriver)) {
+      drivers[volumedriver].reset(
+          new ConcurrencyLimiter(limits.at(volumedriver)));
+    } else if (limits.contains(DVDI_ANY_DRIVER)) {
+      drivers[volumedriver].reset(
+          new ConcurrencyLimiter(limits.at(DVDI_ANY_DRIVER)));
+    } else {
+      drivers[volumedriver] = nullptr;
+    }
+  }
+
+  return drivers[volumedriver];
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,258 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_ADMISSION_QUEUE_HPP_
+#define SRC_ADMISSION_QUEUE_HPP_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <process/future.hpp>
+#include <process/owned.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/try.hpp>
+
+#include "metrics.hpp"
+
+namespace mesos {
+namespace slave {
+
+// Key of driver_concurrency_limits setting the limit of the volume
+// drivers it does not list.
+static constexpr char DVDI_ANY_DRIVER[]           = "*";
+
+// Caps the number of operations running at the same time. Callers
+// acquire() a slot before starting work and must release() it once
+// done; waiters are admitted highest priority first, in FIFO order
+// among equal priorities. Discarding a waiting acquire() gives up its
+// place in the queue, no slot is then held.
+//
+// Must be owned by a std::shared_ptr.
+class ConcurrencyLimiter
+  : public std::enable_shared_from_this<ConcurrencyLimiter>
+{
+public:
+  explicit ConcurrencyLimiter(size_t _limit) : limit(_limit), active(0) {}
+
+  process::Future<Nothing> acquire(int priority = 0)
+  {
+    process::Owned<process::Promise<Nothing>> waiter(
+        new process::Promise<Nothing>());
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (active < limit) {
+        active++;
+        return Nothing();
+      }
+
+      // Equal keys keep their insertion order.
+      waiters.insert(std::make_pair(priority, waiter));
+    }
+
+    const std::weak_ptr<ConcurrencyLimiter> self = shared_from_this();
+    const process::Promise<Nothing>* promise = waiter.get();
+
+    return waiter->future()
+      .onDiscard([self, promise]() {
+        const std::shared_ptr<ConcurrencyLimiter> limiter = self.lock();
+        if (limiter) {
+          limiter->cancel(promise);
+        }
+      });
+  }
+
+  void release()
+  {
+    process::Owned<process::Promise<Nothing>> next;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (waiters.empty()) {
+        active--;
+        return;
+      }
+      // The slot is handed straight to the next waiter.
+      next = waiters.begin()->second;
+      waiters.erase(waiters.begin());
+    }
+    next->set(Nothing());
+  }
+
+  // Number of callers waiting for a slot.
+  size_t queued()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return waiters.size();
+  }
+
+private:
+  // Removes a discarded waiter, unless release() already handed it a
+  // slot.
+  void cancel(const process::Promise<Nothing>* promise)
+  {
+    process::Owned<process::Promise<Nothing>> waiter;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+        if (it->second.get() == promise) {
+          waiter = it->second;
+          waiters.erase(it);
+          break;
+        }
+      }
+    }
+
+    if (waiter.get() != nullptr) {
+      waiter->discard();
+    }
+  }
+
+  const size_t limit;
+  size_t active;
+  std::multimap<
+      int,
+      process::Owned<process::Promise<Nothing>>,
+      std::greater<int>> waiters;
+  std::mutex mutex;
+};
+
+
+// Parses driver_concurrency_limits, a comma separated list of
+// volumedriver=limit, e.g. "rexray=4,*=8".
+Try<hashmap<std::string, size_t>> parseDriverLimits(const std::string& value);
+
+
+// Admits the mounts and unmounts of the isolator.
+//
+// Storage APIs throttle concurrent attach calls per account, and a
+// driver retrying throttled calls only gets slower with more of them in
+// flight. So every operation first waits for a slot of its volume
+// driver, if the driver has a limit, then for one of the agent wide
+// limit shared by all drivers. Both queues admit the operation of
+// highest priority first, see DVDI_VOLUME_PRIORITY.
+//
+// Safe to use from any thread.
+class AdmissionQueue
+{
+public:
+  AdmissionQueue(
+      size_t agentLimit,
+      const hashmap<std::string, size_t>& driverLimits);
+
+  // Runs the operation once admitted, freeing its slots on completion.
+  // Discarding the result while it waits leaves the queues. Accounts
+  // the wait in the driver's queued_operations and queue_wait_ms
+  // metrics.
+  template <typename T>
+  process::Future<T> admit(
+      const std::string& volumedriver,
+      int priority,
+      VolumeDriverMetrics& metrics,
+      const std::function<process::Future<T>()>& operation)
+  {
+    const std::shared_ptr<ConcurrencyLimiter> driverLimiter =
+      driver(volumedriver);
+    const std::shared_ptr<ConcurrencyLimiter> agentLimiter = agent;
+    const std::shared_ptr<Admission> admission(new Admission());
+
+    process::Future<Nothing> admitted = Nothing();
+    if (driverLimiter) {
+      admitted = driverLimiter->acquire(priority);
+      granted(admitted, driverLimiter, admission);
+    }
+
+    VolumeDriverMetrics* driverMetrics = &metrics;
+    ++driverMetrics->queued;
+
+    return driverMetrics->queue_wait.time(admitted
+      .then([agentLimiter, admission, priority]() {
+        process::Future<Nothing> acquired = agentLimiter->acquire(priority);
+        granted(acquired, agentLimiter, admission);
+        return acquired;
+      }))
+      .onAny([driverMetrics]() { --driverMetrics->queued; })
+      .then(operation)
+      .onAny([admission]() { admission->finish(); });
+  }
+
+private:
+  // Slots held by one admitted operation. A slot is only released if
+  // it was granted, and a slot granted after the operation was given
+  // up on is released right away.
+  struct Admission
+  {
+    std::mutex mutex;
+    bool finished = false;
+    std::vector<std::shared_ptr<ConcurrencyLimiter>> held;
+
+    void hold(const std::shared_ptr<ConcurrencyLimiter>& limiter)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!finished) {
+          held.push_back(limiter);
+          return;
+        }
+      }
+      limiter->release();
+    }
+
+    void finish()
+    {
+      std::vector<std::shared_ptr<ConcurrencyLimiter>> released;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        released.swap(held);
+      }
+      for (size_t i = 0; i < released.size(); i++) {
+        released[i]->release();
+      }
+    }
+  };
+
+  // Records the slot in the admission once the limiter grants it. Set
+  // on the acquire() itself, as a continuation would not run if the
+  // operation was discarded in the meantime.
+  static void granted(
+      const process::Future<Nothing>& acquired,
+      const std::shared_ptr<ConcurrencyLimiter>& limiter,
+      const std::shared_ptr<Admission>& admission)
+  {
+    acquired.onReady([limiter, admission]() { admission->hold(limiter); });
+  }
+
+  // The driver's limiter, none if it has no limit of its own.
+  std::shared_ptr<ConcurrencyLimiter> driver(const std::string& volumedriver);
+
+  const std::shared_ptr<ConcurrencyLimiter> agent;
+  const hashmap<std::string, size_t> limits;
+
+  std::mutex mutex;
+  hashmap<std::string, std::shared_ptr<ConcurrencyLimiter>> drivers;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_ADMISSION_QUEUE_HPP_ */
@@ -0,0 +1,187 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mount.h>
+#include <sys/stat.h>
+
+#include <process/io.hpp>
+#include <process/reap.hpp>
+
+#include <stout/error.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/try.hpp>
+
+#include "bind_mount.hpp"
+
+using std::string;
+using std::vector;
+
+using process::Failure;
+using process::Future;
+
+namespace mesos {
+namespace slave {
+
+// What the child reports through its pipe before exiting. `index` is
+// that of the failed mount, -1 if entering the namespace failed, and
+// the number of mounts if all succeeded.
+struct BindMountReport
+{
+  int index;
+  int error;
+};
+
+// Only async-signal-safe calls from here on, the agent has other
+// threads whose locks the child may have inherited held.
+[[noreturn]] static void report(int fd, int index, int error)
+{
+  const BindMountReport result = {index, error};
+  while (::write(fd, &result, sizeof(result)) < 0 && errno == EINTR) {}
+  ::_exit(error == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+Future<Nothing> bindMounts(pid_t pid, const vector<BindMount>& mounts)
+{
+  if (mounts.empty()) {
+    return Nothing();
+  }
+
+  const string namespacePath =
+    path::join("/proc", stringify(pid), "ns", "mnt");
+
+  Try<int> ns = os::open(namespacePath, O_RDONLY | O_CLOEXEC);
+  if (ns.isError()) {
+    return Failure("Failed to open the mount namespace of pid " +
+                   stringify(pid) + ": " + ns.error());
+  }
+
+  // A container launched without a mount namespace of its own shares
+  // the agent's, there is nothing to enter.
+  struct stat own;
+  struct stat target;
+  if (::stat("/proc/self/ns/mnt", &own) != 0 ||
+      ::fstat(ns.get(), &target) != 0) {
+    ErrnoError error("Failed to stat mount namespaces");
+    os::close(ns.get());
+    return Failure(error.message);
+  }
+  const bool enter =
+    own.st_dev != target.st_dev || own.st_ino != target.st_ino;
+
+  int pipes[2];
+  if (::pipe2(pipes, O_CLOEXEC) != 0) {
+    ErrnoError error("Failed to create a pipe");
+    os::close(ns.get());
+    return Failure(error.message);
+  }
+
+  const pid_t child = ::fork();
+  if (child < 0) {
+    ErrnoError error("Failed to fork");
+    os::close(ns.get());
+    os::close(pipes[0]);
+    os::close(pipes[1]);
+    return Failure(error.message);
+  }
+
+  if (child == 0) {
+    if (enter) {
+      if (::setns(ns.get(), CLONE_NEWNS) != 0) {
+        report(pipes[1], -1, errno);
+      }
+
+      // Keeps the volumes from propagating back into the agent's
+      // namespace when its root is a shared mount.
+      if (::mount(NULL, "/", NULL, MS_REC | MS_SLAVE, NULL) != 0) {
+        report(pipes[1], -1, errno);
+      }
+    }
+
+    for (size_t i = 0; i < mounts.size(); i++) {
+      if (::mount(mounts[i].source.c_str(),
+                  mounts[i].target.c_str(),
+                  NULL,
+                  MS_BIND | MS_REC,
+                  NULL) != 0) {
+        report(pipes[1], i, errno);
+      }
+
+      // MS_RDONLY is ignored when creating a bind mount, it only takes
+      // effect on a remount.
+      if (mounts[i].readOnly &&
+          ::mount(NULL,
+                  mounts[i].target.c_str(),
+                  NULL,
+                  MS_BIND | MS_REMOUNT | MS_RDONLY,
+                  NULL) != 0) {
+        report(pipes[1], i, errno);
+      }
+    }
+
+    report(pipes[1], mounts.size(), 0);
+  }
+
+  os::close(ns.get());
+  os::close(pipes[1]);
+
+  // Only to keep the child from staying a zombie, its report tells
+  // how it went.
+  process::reap(child);
+
+  const int reader = pipes[0];
+  Try<Nothing> nonblock = os::nonblock(reader);
+  if (nonblock.isError()) {
+    os::close(reader);
+    return Failure("Failed to read the bind mount report: " +
+                   nonblock.error());
+  }
+
+  return process::io::read(reader)
+    .onAny([reader]() { os::close(reader); })
+    .then([pid, mounts](const string& data) -> Future<Nothing> {
+      BindMountReport result;
+      if (data.size() != sizeof(result)) {
+        return Failure("Bind mounting in the mount namespace of pid " +
+                       stringify(pid) + " terminated without a report");
+      }
+      memcpy(&result, data.data(), sizeof(result));
+
+      if (result.error == 0) {
+        return Nothing();
+      }
+
+      if (result.index < 0 || result.index >= (int) mounts.size()) {
+        return Failure("Failed to enter the mount namespace of pid " +
+                       stringify(pid) + ": " + ::strerror(result.error));
+      }
+
+      const BindMount& failed = mounts[result.index];
+      return Failure("Failed to bind mount " + failed.source + " at " +
+                     failed.target + ": " + ::strerror(result.error));
+    });
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,57 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_BIND_MOUNT_HPP_
+#define SRC_BIND_MOUNT_HPP_
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <process/future.hpp>
+
+#include <stout/nothing.hpp>
+
+namespace mesos {
+namespace slave {
+
+struct BindMount
+{
+  std::string source;
+  std::string target;
+  bool readOnly;
+};
+
+// Recursively bind mounts each source at its target inside the mount
+// namespace of `pid`, stopping at the first failure. A read-only bind
+// mount is then remounted read-only. This leaves the source and other
+// bind mounts of it writable, and so are mounts nested under the source.
+//
+// setns(2) refuses to move a multithreaded process into another mount
+// namespace, so the mounts are made by a forked child of the agent that
+// does not exec. The paths are those of the agent: isolate() runs before
+// the container changes its root.
+process::Future<Nothing> bindMounts(
+    pid_t pid,
+    const std::vector<BindMount>& mounts);
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_BIND_MOUNT_HPP_ */
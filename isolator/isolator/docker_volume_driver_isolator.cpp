@@ -17,8 +17,10 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 
 #include <mesos/mesos.hpp>
@@ -30,15 +32,25 @@
 #include <glog/logging.h>
 #include <mesos/type_utils.hpp>
 
+#include <process/after.hpp>
+#include <process/clock.hpp>
+#include <process/collect.hpp>
+#include <process/defer.hpp>
+#include <process/dispatch.hpp>
+#include <process/help.hpp>
+#include <process/http.hpp>
 #include <process/process.hpp>
-#include <process/subprocess.hpp>
 
+#include "linux/cgroups.hpp"
 #include "linux/fs.hpp"
 using namespace mesos::internal;
 #include <stout/foreach.hpp>
 #include <stout/error.hpp>
+#include <stout/json.hpp>
 #include <stout/nothing.hpp>
+#include <stout/numify.hpp>
 #include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
 #include <stout/format.hpp>
 #include <stout/strings.hpp>
 
@@ -48,6 +60,7 @@ using std::list;
 using std::string;
 using std::stringstream;
 using std::array;
+using std::vector;
 
 using namespace mesos;
 using namespace mesos::slave;
@@ -59,6 +72,14 @@ using mesos::slave::Limitation;
 #endif
 using mesos::slave::Isolator;
 
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+using PrepareInfo = Option<CommandInfo>;
+#elif MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 270
+using PrepareInfo = Option<ContainerPrepareInfo>;
+#else
+using PrepareInfo = Option<ContainerLaunchInfo>;
+#endif
+
 //TODO temporary code until checkpoints are public by mesosphere dev
 #include <stout/path.hpp>
 #include <slave/paths.hpp>
@@ -78,14 +99,90 @@ const char DockerVolumeDriverIsolator::prohibitedchars[NUM_PROHIBITED]  =
 
 string DockerVolumeDriverIsolator::mountPbFilename;
 string DockerVolumeDriverIsolator::mesosWorkingDir;
+string DockerVolumeDriverIsolator::stateDir;
+bool DockerVolumeDriverIsolator::recoverAgentState;
+bool DockerVolumeDriverIsolator::ioThrottling;
+string DockerVolumeDriverIsolator::defaultBackend;
+string DockerVolumeDriverIsolator::pluginSocketDir;
+string DockerVolumeDriverIsolator::fakeBackendDir;
+Duration DockerVolumeDriverIsolator::fakeBackendLatency;
+double DockerVolumeDriverIsolator::fakeBackendFailureRate;
+size_t DockerVolumeDriverIsolator::maxConcurrentOperations;
+hashmap<string, size_t> DockerVolumeDriverIsolator::driverConcurrencyLimits;
+size_t DockerVolumeDriverIsolator::journalCompactionInterval;
+Duration DockerVolumeDriverIsolator::journalCommitWindow;
+size_t DockerVolumeDriverIsolator::recoverConcurrency;
+Duration DockerVolumeDriverIsolator::recoverUnmountTimeout;
+Duration DockerVolumeDriverIsolator::unmountGracePeriod;
+Duration DockerVolumeDriverIsolator::usageSampleInterval;
+Option<string> DockerVolumeDriverIsolator::blkioHierarchy;
 
 DockerVolumeDriverIsolator::DockerVolumeDriverIsolator(
   const Parameters& _parameters)
-  : parameters(_parameters)
+  : parameters(_parameters),
+    isolatorProcess(new DockerVolumeDriverIsolatorProcess()),
+    journal(new MountJournal(
+        path::join(stateDir, DVDI_JOURNAL_DIRNAME),
+        journalCompactionInterval)),
+    journalWriter(new MountJournalWriter(journal, journalCommitWindow)),
+    admissions(new AdmissionQueue(
+        maxConcurrentOperations, driverConcurrencyLimits)),
+    detachLimiter(new ConcurrencyLimiter(maxConcurrentOperations)),
+    metrics(new DvdiMetrics()),
+    statsSampler(new VolumeStatsSampler())
   {
     // Verify that the version of the library that we linked against is
     // compatible with the version of the headers we compiled against.
     GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+    backends[DVDI_BACKEND_DVDCLI].reset(new DvdcliBackend());
+    backends[DVDI_BACKEND_PLUGIN].reset(
+        new VolumePluginClient(pluginSocketDir));
+
+    // Only on agents whose operator asked for it: a task or a pre-attach
+    // naming it would otherwise get an empty directory for its volume.
+    // Tasks and pre-attaches asking for it are rejected as for any
+    // unknown backend.
+    if (defaultBackend == DVDI_BACKEND_FAKE) {
+      backends[DVDI_BACKEND_FAKE].reset(new FakeBackend(
+          fakeBackendDir, fakeBackendLatency, fakeBackendFailureRate));
+    }
+
+    isolatorProcess->serve(
+        DVDI_PREATTACH_ENDPOINT,
+#if MESOS_VERSION_INT >= 100 && MESOS_VERSION_INT < 200
+        DVDI_PREATTACH_REALM,
+#endif
+        HELP(
+            TLDR("Mounts a volume ahead of the task that will use it."),
+            DESCRIPTION(
+                "POST a form with volumename and optionally volumedriver,",
+                "options, backend and ttl (default " +
+                  string(DEFAULT_PREATTACH_TTL) + ").",
+                "The volume stays mounted for ttl, a task using it within",
+                "that time only has it bind mounted.")),
+        [this](const http::Request& request) { return preattach(request); });
+
+    isolatorProcess->serve(
+        DVDI_VOLUMES_ENDPOINT,
+        HELP(
+            TLDR("Lists the external volumes mounted on the agent."),
+            DESCRIPTION(
+                "Each volume comes with its mountpoint, the containers using",
+                "it and when it was mounted. Pass ?version=<version> from",
+                "the last response to wait until the list changes, for at",
+                "most ?timeout=<duration> (default " +
+                  string(DEFAULT_VOLUMES_WATCH_TIMEOUT) + ").")),
+        [this](const http::Request& request) { return volumes(request); });
+
+    process::spawn(isolatorProcess.get());
+    process::spawn(journalWriter.get());
+    process::spawn(statsSampler.get());
+
+    if (usageSampleInterval > Duration::zero()) {
+      dispatch(isolatorProcess->self(),
+               std::function<void()>([this]() { sampleUsage(); }));
+    }
   }
 
 Try<Isolator*> DockerVolumeDriverIsolator::create(
@@ -103,6 +200,23 @@ Try<Isolator*> DockerVolumeDriverIsolator::create(
 
   LOG(INFO) << "DockerVolumeDriverIsolator::create() called";
   mesosWorkingDir = DEFAULT_WORKING_DIR;
+  stateDir = DVDI_MOUNTLIST_PATH;
+  recoverAgentState = false;
+  ioThrottling = false;
+  defaultBackend = DVDI_BACKEND_DVDCLI;
+  pluginSocketDir = DEFAULT_PLUGIN_SOCKET_DIR;
+  fakeBackendDir = DEFAULT_FAKE_BACKEND_DIR;
+  fakeBackendLatency = Duration::zero();
+  fakeBackendFailureRate = 0;
+  maxConcurrentOperations = DEFAULT_MAX_CONCURRENT_OPERATIONS;
+  driverConcurrencyLimits.clear();
+  journalCompactionInterval = DEFAULT_JOURNAL_COMPACTION_INTERVAL;
+  journalCommitWindow = Duration::parse(DEFAULT_JOURNAL_COMMIT_WINDOW).get();
+  recoverConcurrency = DEFAULT_RECOVER_CONCURRENCY;
+  recoverUnmountTimeout =
+    Duration::parse(DEFAULT_RECOVER_UNMOUNT_TIMEOUT).get();
+  unmountGracePeriod = Duration::parse(DEFAULT_UNMOUNT_GRACE_PERIOD).get();
+  usageSampleInterval = Duration::parse(DEFAULT_USAGE_SAMPLE_INTERVAL).get();
 
   foreach (const Parameter& parameter, parameters.parameter()) {
     if (parameter.key() == DVDI_WORKDIR_PARAM_NAME) {
@@ -117,11 +231,225 @@ Try<Isolator*> DockerVolumeDriverIsolator::create(
            << " parameter is invalid, must start with /";
         return Error(ss.str());
       }
+    } else if (parameter.key() == DVDI_STATEDIR_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (parameter.value().length() > 1 &&
+          strings::startsWith(parameter.value(), "/")) {
+        stateDir = parameter.value();
+      } else {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_STATEDIR_PARAM_NAME
+           << " parameter is invalid, must start with /";
+        return Error(ss.str());
+      }
+    } else if (parameter.key() == DVDI_RECOVERSTATE_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (parameter.value() == "true") {
+        recoverAgentState = true;
+      } else if (parameter.value() == "false") {
+        recoverAgentState = false;
+      } else {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_RECOVERSTATE_PARAM_NAME
+           << " parameter is invalid, must be true or false";
+        return Error(ss.str());
+      }
+    } else if (parameter.key() == DVDI_IOTHROTTLING_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (parameter.value() == "true") {
+        ioThrottling = true;
+      } else if (parameter.value() == "false") {
+        ioThrottling = false;
+      } else {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_IOTHROTTLING_PARAM_NAME
+           << " parameter is invalid, must be true or false";
+        return Error(ss.str());
+      }
+    } else if (parameter.key() == DVDI_BACKEND_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (parameter.value() != DVDI_BACKEND_DVDCLI &&
+          parameter.value() != DVDI_BACKEND_PLUGIN &&
+          parameter.value() != DVDI_BACKEND_FAKE) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_BACKEND_PARAM_NAME
+           << " parameter is invalid, must be " << DVDI_BACKEND_DVDCLI
+           << ", " << DVDI_BACKEND_PLUGIN << " or " << DVDI_BACKEND_FAKE;
+        return Error(ss.str());
+      }
+      defaultBackend = parameter.value();
+    } else if (parameter.key() == DVDI_PLUGINDIR_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (!strings::startsWith(parameter.value(), "/")) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_PLUGINDIR_PARAM_NAME
+           << " parameter is invalid, must start with /";
+        return Error(ss.str());
+      }
+      pluginSocketDir = parameter.value();
+    } else if (parameter.key() == DVDI_FAKEDIR_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      if (parameter.value().length() <= 1 ||
+          !strings::startsWith(parameter.value(), "/")) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_FAKEDIR_PARAM_NAME
+           << " parameter is invalid, must start with /";
+        return Error(ss.str());
+      }
+      fakeBackendDir = parameter.value();
+    } else if (parameter.key() == DVDI_FAKELATENCY_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<Duration> latency = Duration::parse(parameter.value());
+      if (latency.isError() || latency.get() < Duration::zero()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_FAKELATENCY_PARAM_NAME
+           << " parameter is invalid, must be a duration such as 100ms";
+        return Error(ss.str());
+      }
+      fakeBackendLatency = latency.get();
+    } else if (parameter.key() == DVDI_FAKEFAILURES_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<double> rate = numify<double>(parameter.value());
+      if (rate.isError() || rate.get() < 0 || rate.get() > 1) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_FAKEFAILURES_PARAM_NAME
+           << " parameter is invalid, must be a number from 0 to 1";
+        return Error(ss.str());
+      }
+      fakeBackendFailureRate = rate.get();
+    } else if (parameter.key() == DVDI_MAXCONCURRENT_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<size_t> limit = numify<size_t>(parameter.value());
+      if (limit.isError() || limit.get() == 0) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_MAXCONCURRENT_PARAM_NAME
+           << " parameter is invalid, must be a positive integer";
+        return Error(ss.str());
+      }
+      maxConcurrentOperations = limit.get();
+    } else if (parameter.key() == DVDI_DRIVERLIMITS_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<hashmap<string, size_t>> limits =
+        parseDriverLimits(parameter.value());
+      if (limits.isError()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_DRIVERLIMITS_PARAM_NAME
+           << " parameter is invalid: " << limits.error();
+        return Error(ss.str());
+      }
+      driverConcurrencyLimits = limits.get();
+    } else if (parameter.key() == DVDI_COMPACTION_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<size_t> interval = numify<size_t>(parameter.value());
+      if (interval.isError() || interval.get() == 0) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_COMPACTION_PARAM_NAME
+           << " parameter is invalid, must be a positive integer";
+        return Error(ss.str());
+      }
+      journalCompactionInterval = interval.get();
+    } else if (parameter.key() == DVDI_COMMITWINDOW_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<Duration> window = Duration::parse(parameter.value());
+      if (window.isError()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_COMMITWINDOW_PARAM_NAME
+           << " parameter is invalid, must be a duration such as 5ms";
+        return Error(ss.str());
+      }
+      journalCommitWindow = window.get();
+    } else if (parameter.key() == DVDI_RECOVERCONCURRENCY_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<size_t> concurrency = numify<size_t>(parameter.value());
+      if (concurrency.isError() || concurrency.get() == 0) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator "
+           << DVDI_RECOVERCONCURRENCY_PARAM_NAME
+           << " parameter is invalid, must be a positive integer";
+        return Error(ss.str());
+      }
+      recoverConcurrency = concurrency.get();
+    } else if (parameter.key() == DVDI_RECOVERTIMEOUT_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<Duration> timeout = Duration::parse(parameter.value());
+      if (timeout.isError() || timeout.get() <= Duration::zero()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_RECOVERTIMEOUT_PARAM_NAME
+           << " parameter is invalid, must be a duration such as 2mins";
+        return Error(ss.str());
+      }
+      recoverUnmountTimeout = timeout.get();
+    } else if (parameter.key() == DVDI_GRACEPERIOD_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<Duration> gracePeriod = Duration::parse(parameter.value());
+      if (gracePeriod.isError() || gracePeriod.get() < Duration::zero()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_GRACEPERIOD_PARAM_NAME
+           << " parameter is invalid, must be a duration such as 5mins";
+        return Error(ss.str());
+      }
+      unmountGracePeriod = gracePeriod.get();
+    } else if (parameter.key() == DVDI_USAGEINTERVAL_PARAM_NAME) {
+      LOG(INFO) << "parameter " << parameter.key() << ":" << parameter.value();
+
+      Try<Duration> interval = Duration::parse(parameter.value());
+      if (interval.isError() || interval.get() < Duration::zero()) {
+        std::stringstream ss;
+        ss << "DockerVolumeDriverIsolator " << DVDI_USAGEINTERVAL_PARAM_NAME
+           << " parameter is invalid, must be a duration such as 15secs";
+        return Error(ss.str());
+      }
+      usageSampleInterval = interval.get();
+    }
+  }
+
+  // Throttling is up to the operator, who knows whether the agent runs
+  // the cgroups/blkio isolator: its cgroups and ours would each take
+  // the task out of the other. Where the agent's flags show it, the
+  // module refuses to load.
+  blkioHierarchy = None();
+  if (ioThrottling) {
+    if (agentIsolatesBlkio()) {
+      std::stringstream ss;
+      ss << "DockerVolumeDriverIsolator " << DVDI_IOTHROTTLING_PARAM_NAME
+         << " cannot be used with the agent's " << MESOS_BLKIO_ISOLATOR
+         << " isolator";
+      return Error(ss.str());
+    }
+
+    Result<string> hierarchy = cgroups::hierarchy("blkio");
+    if (!hierarchy.isSome()) {
+      std::stringstream ss;
+      ss << "DockerVolumeDriverIsolator " << DVDI_IOTHROTTLING_PARAM_NAME
+         << " needs the blkio cgroup hierarchy, which is not mounted";
+      return Error(ss.str());
     }
+
+    blkioHierarchy = hierarchy.get();
+    LOG(INFO) << "using blkio hierarchy " << blkioHierarchy.get()
+              << " to throttle volume I/O";
+  } else {
+    LOG(INFO) << DVDI_IOTHROTTLING_PARAM_NAME << " is off, volume I/O "
+              << "cannot be throttled";
   }
 
-  mountPbFilename = path::join(DVDI_MOUNTLIST_PATH, DVDI_MOUNTLIST_FILENAME);
-  LOG(INFO) << "using " << mountPbFilename;
+  mountPbFilename = path::join(stateDir, DVDI_MOUNTLIST_FILENAME);
+  LOG(INFO) << "using " << path::join(stateDir, DVDI_JOURNAL_DIRNAME);
 
 #if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
   process::Owned<IsolatorProcess> process(
@@ -135,6 +463,16 @@ Try<Isolator*> DockerVolumeDriverIsolator::create(
 
 DockerVolumeDriverIsolator::~DockerVolumeDriverIsolator()
 {
+  process::terminate(isolatorProcess.get());
+  process::wait(isolatorProcess.get());
+
+  process::terminate(journalWriter.get());
+  process::wait(journalWriter.get());
+
+  // A sample stuck on an unresponsive volume is not waited for, the
+  // actor goes once it returns.
+  process::terminate(statsSampler.get());
+
   // Delete all global objects allocated by libprotobuf.
   google::protobuf::ShutdownProtobufLibrary();
 }
@@ -151,62 +489,101 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
 {
   LOG(INFO) << "DockerVolumeDriverIsolator recover() was called";
 
+  // Everything from here on reads or modifies infos, lingering and
+  // the journal, so it is serialized on the isolator actor.
+  const std::function<Future<Nothing>()> recoverMounts =
+    [=]() { return _recover(states, orphans); };
+
+  return dispatch(isolatorProcess->self(), recoverMounts);
+}
+
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+Future<Nothing> DockerVolumeDriverIsolator::_recover(
+    const list<ExecutorRunState>& states,
+    const hashset<ContainerID>& orphans)
+#else
+Future<Nothing> DockerVolumeDriverIsolator::_recover(
+    const list<ContainerState>& states,
+    const hashset<ContainerID>& orphans)
+#endif
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
   // Slave recovery is a feature of Mesos that allows task/executors
   // to keep running if a slave process goes down, AND
   // allows the slave process to reconnect with already running
   // slaves when it restarts.
-  // The orphans parameter is list of tasks (ContainerID) still running now.
   // The states parameter is a list of structures containing a tuples
   // of (ContainerID, pid, directory) where directory is the slave directory
   // specified at task launch.
+  // The orphans parameter is a list of containers (ContainerID) still
+  // running but unknown to the agent, they will be destroyed by the
+  // containerizer, which calls cleanup() for each of them.
   // We need to rebuild mount ref counts using these.
   // However there is also a possibility that a task
   // terminated while we were gone, leaving a "orphanned" mount.
   // If any of these exist, they should be unmounted.
+  // Mesos has already recovered its own state to compute the arguments,
+  // so they and the mount journal are all we need.
 
-  // originalContainerMounts is a multihashmap is similar to the infos
-  // multihashmap but note that the key is an std::string instead of a
+  // originalContainerMounts is a multihashmap is similar to the one in
+  // MountTable but note that the key is an std::string instead of a
   // ContainerID. This is because some of the ContainerIDs present when
   // it was recorded may now be gone. The key is a string rendering of the
   // ContainerID but not a ContainerID.
   multihashmap<string, process::Owned<ExternalMount>>
       originalContainerMounts;
 
-  // Recover the state.
-  //TODO: need public version of recover in checkpointing
-  LOG(INFO) << "dvdicheckpoint::recover() called";
-  Result<State> resultState =
-    mesos::internal::slave::state::recover(mesosWorkingDir, true);
-  if (resultState.isNone()) {
-    LOG(INFO) << "dvdicheckpoint::recover(): recover state is NONE";
-    return Nothing();
-  }
+  // Re-reading the agent's meta directory only double checks what
+  // Mesos already told us and is slow on agents with a long history,
+  // it is kept as an opt-in for agents that want the extra check.
+  if (recoverAgentState) {
+    LOG(INFO) << "dvdicheckpoint::recover() called";
+    Result<State> resultState =
+      mesos::internal::slave::state::recover(mesosWorkingDir, true);
+    if (resultState.isNone()) {
+      LOG(INFO) << "dvdicheckpoint::recover(): recover state is NONE";
+      return Nothing();
+    }
 
-  State state = resultState.get();
-  LOG(INFO) << "dvdicheckpoint::recover() returned: " << state.errors;
+    State state = resultState.get();
+    LOG(INFO) << "dvdicheckpoint::recover() returned: " << state.errors;
 
-  if (state.errors != 0) {
-    LOG(INFO) << "recover state error:" << state.errors;
-    return Nothing();
+    if (state.errors != 0) {
+      LOG(INFO) << "recover state error:" << state.errors;
+      return Nothing();
+    }
   }
 
-  // read container mounts from filesystem
-  std::ifstream ifs(mountPbFilename);
-
-  if (!os::exists(mountPbFilename)) {
-    LOG(INFO) << "No mount protobuf file exists at " << mountPbFilename
-              << " so there are no mounts to recover";
+  // read container mounts from the journal
+  Try<ExternalMountList> recovered = journal->recover();
+  if (recovered.isError()) {
+    LOG(ERROR) << "Failed to recover the mount journal: "
+               << recovered.error();
     return Nothing();
   }
 
-  LOG(INFO) << "Parsing mount protobuf file(" << mountPbFilename
-            << ") in recover()";
+  ExternalMountList mountlist = recovered.get();
 
-  ExternalMountList mountlist;
-  if( !mountlist.ParseFromIstream(&ifs) )
-  {
-    LOG(INFO) << "Invalid protobuf data contained within " << mountPbFilename;
-    return Nothing();
+  // Agents upgraded from a release without the journal still have
+  // the whole mount list in a single file.
+  if (mountlist.mount_size() == 0 && os::exists(mountPbFilename)) {
+    LOG(INFO) << "Parsing legacy mount protobuf file(" << mountPbFilename
+              << ") in recover()";
+
+    Result<ExternalMountList> legacy =
+      ::protobuf::read<ExternalMountList>(mountPbFilename);
+    if (legacy.isSome()) {
+      mountlist = legacy.get();
+    } else {
+      std::ifstream ifs(mountPbFilename);
+      if (!mountlist.ParseFromIstream(&ifs)) {
+        LOG(INFO) << "Invalid protobuf data contained within "
+                  << mountPbFilename;
+        return Nothing();
+      }
+    }
   }
 
   for (int i = 0; i < mountlist.mount_size(); i++)
@@ -231,17 +608,22 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
         mount.set_volumename(string(""));
       }
 
+      // Recompute rather than trust the key stored in the file,
+      // it may predate the key or a change in normalization.
+      mount.set_volume_key(
+          volumeKey(mount.volumedriver(), mount.volumename()));
+
       if (!mount.containerid().empty() && !mount.volumename().empty()) {
         LOG(INFO) << "Adding to legacyMounts: ";
         LOG(INFO) << mount.SerializeAsString();
 
         originalContainerMounts.put(mount.containerid(),
-          process::Owned<ExternalMount>(&mount));
+          process::Owned<ExternalMount>(new ExternalMount(mount)));
       }
     }
   }
 
-  LOG(INFO) << "Parsed " << mountPbFilename
+  LOG(INFO) << "Parsed the mount journal"
             << " and found evidence of " << originalContainerMounts.size()
             << " previous active external mounts in recover()";
 
@@ -275,7 +657,7 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
       foreach (const process::Owned<ExternalMount> &mount, mountsForContainer) {
 
         // Copy task element to rebuild infos.
-        infos.put(state.id, mount);
+        trackMount(state.id, mount);
         ExternalMountID id = getExternalMountId(*mount);
         LOG(INFO) << "Re-identified a preserved mount, id is " << id;
         inUseMounts.put(id, mount);
@@ -297,7 +679,7 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
 
       foreach (const process::Owned<ExternalMount> &mount, mountsForContainer) {
         // Copy task element to rebuild infos.
-        infos.put(state.container_id(), mount);
+        trackMount(state.container_id(), mount);
         ExternalMountID id = getExternalMountId(*mount);
         LOG(INFO) << "Re-identified a preserved mount, id is " << id;
         inUseMounts.put(id, mount);
@@ -306,16 +688,71 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
   }
 #endif
 
-  // Create ExternalMountList protobuf message to checkpoint
-  ExternalMountList inUseMountsProtobuf;
-  foreachvalue( const process::Owned<ExternalMount> &mount, inUseMounts) {
-    ExternalMount* mptr = inUseMountsProtobuf.add_mount();
-    mptr->CopyFrom(*(mount.get()));
+  // Mounts of orphans stay mounted until the containerizer destroys
+  // them, cleanup() then releases them like any other container's.
+  foreach (const ContainerID& orphan, orphans) {
+    if (originalContainerMounts.contains(orphan.value())) {
+      LOG(INFO) << "Orphan container(" << orphan.value()
+                << ") re-identified on recover()";
+
+      foreach (const process::Owned<ExternalMount> &mount,
+               originalContainerMounts.get(orphan.value())) {
+        trackMount(orphan, mount);
+        inUseMounts.put(getExternalMountId(*mount), mount);
+      }
+    }
+  }
+
+  // The blkio cgroups of containers that are gone, e.g. those whose
+  // cleanup() was interrupted by the agent stopping.
+  if (blkioHierarchy.isSome()) {
+    Try<std::vector<string>> throttled =
+      cgroups::get(blkioHierarchy.get(), DVDI_BLKIO_CGROUP_ROOT);
+    if (throttled.isSome()) {
+      foreach (const string& cgroup, throttled.get()) {
+        ContainerID id;
+        id.set_value(Path(cgroup).basename());
+        if (!infos.contains(id)) {
+          unthrottle(id);
+        }
+      }
+    }
   }
 
-  //checkpoint the dvdi mounts for persistence
-  mesos::internal::slave::state::checkpoint(mountPbFilename,
-      inUseMountsProtobuf);
+  // Detaches still queued when the agent stopped are queued again, for
+  // what is left of their grace period, rather than run here. Those a
+  // container uses again are simply dropped. Their timers only start
+  // once recovery is done, an expiry would otherwise unmount and
+  // journal while the snapshot is being taken.
+  if (originalContainerMounts.contains(DVDI_DETACH_CONTAINER_ID)) {
+    const double now = Clock::now().secs();
+
+    foreach (const process::Owned<ExternalMount> &mount,
+             originalContainerMounts.get(DVDI_DETACH_CONTAINER_ID)) {
+      const ExternalMountID id = getExternalMountId(*mount);
+      if (inUseMounts.contains(id)) {
+        continue;
+      }
+
+      Try<Duration> remaining =
+        Duration::create(mount->linger_until() - now);
+      // A pre-attach keeps its TTL, a detach at most the grace period
+      // configured now.
+      Duration delay = Duration::zero();
+      if (remaining.isSome() && remaining.get() > Duration::zero()) {
+        delay = mount->pinned()
+          ? remaining.get()
+          : std::min(remaining.get(), unmountGracePeriod);
+      }
+
+      LOG(INFO) << "Queueing the detach of volume " << id << " again, "
+                << "starting in " << delay;
+      const process::Owned<ExternalMount> requeued =
+        linger(*mount, delay, false);
+      requeued->set_pinned(mount->pinned());
+      inUseMounts.put(id, mount);
+    }
+  }
 
   // We will now reduce legacyMounts to only the mounts that should be removed.
   // We will do this by deleting the mounts still in use.
@@ -324,255 +761,840 @@ Future<Nothing> DockerVolumeDriverIsolator::recover(
   }
 
   // legacyMounts now contains only "orphan" mounts whose task is gone.
-  // We will attempt to unmount these.
+  std::vector<process::Owned<ExternalMount>> orphanMounts;
   foreachvalue (const process::Owned<ExternalMount> &mount, legacyMounts) {
-    if (!unmount(*(mount.get()), "recover()")) {
-      return Failure("recover() failed during unmount attempt");
-    }
+    orphanMounts.push_back(mount);
   }
 
-  return Nothing();
-}
+  // Checkpoint the dvdi mounts for persistence as a fresh snapshot.
+  // The orphans stay on record until they are unmounted, so a crash
+  // during recovery leaves them to the next recover().
+  // The legacy mount list is only removed once the snapshot holding
+  // its mounts is in place, if compaction fails it is read again by
+  // the next recover().
+  const Future<Nothing> compacted = compactJournal(orphanMounts)
+    .onReady(defer(isolatorProcess->self(), [](const Nothing&) {
+      if (os::exists(mountPbFilename)) {
+        Try<Nothing> rm = os::rm(mountPbFilename);
+        if (rm.isError()) {
+          LOG(WARNING) << "Failed to remove the legacy mount list "
+                       << mountPbFilename << ": " << rm.error();
+        }
+      }
+    }))
+    .onFailed([](const string&) {
+      if (os::exists(mountPbFilename)) {
+        LOG(WARNING) << "Keeping the legacy mount list " << mountPbFilename
+                     << " for the next recovery";
+      }
+    });
 
-// Attempts to unmount specified external mount, returns true on success.
-// Also returns true so long as DVDCLI is successfully invoked,
-// even if a non-zero return code occurs.
-bool DockerVolumeDriverIsolator::unmount(
-    const ExternalMount& em,
-    const string&   callerLabelForLogging ) const
-{
-  LOG(INFO) << em.volumedriver() << "/" << em.volumename()
-            << " is being unmounted on "
-            << callerLabelForLogging;
+  Try<bool> refreshed = mountInfo.refresh();
+  if (refreshed.isError()) {
+    LOG(WARNING) << "Failed to read the agent's mount table: "
+                 << refreshed.error();
+  }
 
-  if (!os::exists(em.dvdcli_path())) {
-    LOG(ERROR) << "The DVDCLI binary doesn't exist at the specified path "
-               << em.dvdcli_path();
-    return false;
+  // Orphans whose filesystem is already gone, e.g. unmounted by hand or
+  // by a reboot, are not worth a dvdcli round trip.
+  std::vector<process::Owned<ExternalMount>> mountedOrphans;
+  foreach (const process::Owned<ExternalMount> &mount, orphanMounts) {
+    if (!mount->mountpoint().empty() && !confirmMounted(*mount)) {
+      LOG(INFO) << "Orphaned mount " << mount->volumedriver() << "/"
+                << mount->volumename() << " is no longer mounted at "
+                << mount->mountpoint() << ", not unmounting it";
+      continue;
+    }
+    mountedOrphans.push_back(mount);
   }
 
-  if (system(NULL)) { // Is a command processor available?
+  // Volumes mounted where REX-Ray mounts them but unknown to the
+  // journal, e.g. mounted by hand, are only reported: we do not know
+  // who else uses them.
+  hashset<string> known;
+  std::vector<process::Owned<ExternalMount>> tracked = orphanMounts;
+  foreachvalue (const process::Owned<ExternalMount> &mount, infos.all()) {
+    tracked.push_back(mount);
+  }
+  foreachvalue (const LingeringMount& lingeringMount, lingering) {
+    tracked.push_back(lingeringMount.mount);
+  }
+  foreach (const process::Owned<ExternalMount> &mount, tracked) {
+    if (!mount->mountpoint().empty()) {
+      const string mountpoint =
+        strings::remove(mount->mountpoint(), "/", strings::SUFFIX);
+      known.insert(mountpoint);
+      known.insert(Path(mountpoint).dirname());
+    }
+  }
+  foreach (const string& target, mountInfo.under(REXRAY_MOUNT_PREFIX)) {
+    if (!known.contains(target)) {
+      LOG(WARNING) << "Found " << target << " mounted, but no container "
+                   << "or queued detach of this agent uses it";
+    }
+  }
 
-    LOG(INFO) << "Invoking " << em.dvdcli_path()
-              << " " << DVDCLI_UNMOUNT_CMD << " "
-              << VOL_DRIVER_CMD_OPTION << em.volumedriver() << " "
-              << VOL_NAME_CMD_OPTION << em.volumename();
+  // We will attempt to unmount the orphans, recoverConcurrency at a time
+  // and each within recoverUnmountTimeout, so recovery takes at most
+  // ceil(orphans / recoverConcurrency) * recoverUnmountTimeout.
+  std::shared_ptr<ConcurrencyLimiter> limiter(
+      new ConcurrencyLimiter(recoverConcurrency));
+  const Duration timeout = recoverUnmountTimeout;
+
+  list<Future<bool>> unmounts;
+  foreach (const process::Owned<ExternalMount> &mount, mountedOrphans) {
+    unmounts.push_back(limiter->acquire()
+      .then([=]() {
+        // A failed orphan stays on record for the next recovery rather
+        // than being assumed gone.
+        return unmount(*mount, "recover()", false)
+          .after(timeout, [timeout](Future<bool> unmount) -> Future<bool> {
+            // Discarding kills the dvdcli child.
+            unmount.discard();
+            return Failure("timed out after " + stringify(timeout));
+          });
+      })
+      .onAny([limiter]() { limiter->release(); }));
+  }
 
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-    std::ostringstream cmdOut;
-    Try<int> retcode = os::shell(&cmdOut, "%s %s %s%s %s%s",
-      em.dvdcli_path().c_str(),
-      DVDCLI_UNMOUNT_CMD,
-      VOL_DRIVER_CMD_OPTION,
-      em.volumedriver().c_str(),
-      VOL_NAME_CMD_OPTION,
-      em.volumename().c_str());
-#else
-    Try<string> retcode = os::shell("%s %s %s%s %s%s ",
-      em.dvdcli_path().c_str(),
-      DVDCLI_UNMOUNT_CMD,
-      VOL_DRIVER_CMD_OPTION,
-      em.volumedriver().c_str(),
-      VOL_NAME_CMD_OPTION,
-      em.volumename().c_str());
-#endif
+  // A failed orphan is reported rather than failing recover(), which
+  // would keep the agent from re-registering.
+  return await(unmounts)
+    .then(defer(isolatorProcess->self(), [=](
+        const list<Future<bool>>& results) -> Future<Nothing> {
+      std::vector<process::Owned<ExternalMount>> failedMounts;
+      std::stringstream report;
+
+      auto mount = mountedOrphans.begin();
+      foreach (const Future<bool>& result, results) {
+        if (!result.isReady() || !result.get()) {
+          failedMounts.push_back(*mount);
+          report << " " << (*mount)->volumedriver() << "/"
+                 << (*mount)->volumename() << " ("
+                 << (result.isFailed() ? result.failure() : "not unmounted")
+                 << ")";
+        }
+        ++mount;
+      }
 
-    if (retcode.isError()) {
-      LOG(WARNING) << em.dvdcli_path() << " " << DVDCLI_UNMOUNT_CMD
-                   << " failed to execute on " << callerLabelForLogging
-                   << ", continuing on the assumption this volume was "
-                   << "manually unmounted previously "
-                   << retcode.error();
-    } else {
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-      LOG(INFO) << em.dvdcli_path() << " " << DVDCLI_UNMOUNT_CMD
-        << " returned " << retcode.get() << ", " << cmdOut.str();
-#else
-      LOG(INFO) << em.dvdcli_path() << " " << DVDCLI_UNMOUNT_CMD
-        << " returned " << retcode.get();
-#endif
-    }
-  } else {
-    LOG(ERROR) << "failed to acquire a command processor for unmount on "
-               << callerLabelForLogging;
-    return false;
-  }
+      if (failedMounts.empty()) {
+        LOG(INFO) << "recover() unmounted all " << mountedOrphans.size()
+                  << " orphaned mounts";
+      } else {
+        LOG(WARNING) << "recover() failed to unmount " << failedMounts.size()
+                     << " of " << mountedOrphans.size() << " orphaned mounts,"
+                     << " they will be retried on the next recovery:"
+                     << report.str();
+      }
 
-  return true;
+      // Queued after the first compaction on journalWriter.
+      const Future<Nothing> recompacted = compactJournal(failedMounts);
+
+      foreachkey (const ExternalMountID& id, lingering) {
+        scheduleExpire(id);
+      }
+
+      metrics->recovered(stopwatch.elapsed());
+
+      // Compaction failures are logged, the journal keeps its log.
+      list<Future<Nothing>> compactions = {compacted, recompacted};
+      return await(compactions)
+        .then([]() { return Nothing(); });
+    }));
 }
 
-string formatOptions(const string& options)
+bool DockerVolumeDriverIsolator::confirmMounted(const ExternalMount& em)
 {
-  std::stringstream buf;
-  std::size_t i = 0, j = options.find(",");
+  if (!backend(em)->mountsFilesystem()) {
+    return true;
+  }
 
-  while (j != std::string::npos) {
-    if (j > i) {
-      buf << " " << VOL_OPTS_CMD_OPTION << options.substr(i, j-i);
-    }
-    i = j+1;
-    j = options.find(",", i);
+  Try<bool> refreshed = mountInfo.refresh();
+  if (refreshed.isError()) {
+    LOG(WARNING) << "Failed to read the agent's mount table: "
+                 << refreshed.error();
+    return true;
   }
-  if (i < options.size()) {
-      buf << " " << VOL_OPTS_CMD_OPTION << options.substr(i);
+
+  return mountInfo.mounted(em.mountpoint());
+}
+
+// Returns the backend serving the volume, dvdcli unless the mount
+// names another one.
+std::shared_ptr<VolumeBackend> DockerVolumeDriverIsolator::backend(
+    const ExternalMount& em) const
+{
+  if (em.has_backend() && backends.contains(em.backend())) {
+    return backends.at(em.backend());
   }
-  return buf.str();
+  return backends.at(DVDI_BACKEND_DVDCLI);
 }
 
-// Attempts to mount specified external mount,
-// returns non-empty string (mountpoint) on success.
-string DockerVolumeDriverIsolator::mount(
+// Attempts to unmount specified external mount, returned future is
+// true on success. Unless assumeUnmounted is false, also true so long
+// as the backend is successfully invoked, even if a non-zero return
+// code occurs.
+Future<bool> DockerVolumeDriverIsolator::unmount(
     const ExternalMount& em,
-    const string&   callerLabelForLogging) const
+    const string&   callerLabelForLogging,
+    bool            assumeUnmounted) const
 {
   LOG(INFO) << em.volumedriver() << "/" << em.volumename()
-            << " is being mounted on "
+            << " is being unmounted on "
             << callerLabelForLogging;
 
-  if (!os::exists(em.dvdcli_path())) {
-    LOG(ERROR) << "The DVDCLI binary doesn't exist at the specified path "
-               << em.dvdcli_path();
+  const std::shared_ptr<VolumeBackend> volumeBackend = backend(em);
+
+  Option<string> unavailable = volumeBackend->unavailable(em);
+  if (unavailable.isSome()) {
+    LOG(ERROR) << unavailable.get();
     return false;
   }
 
-  string mountpoint; // Return value init'd to empty.
-  const string options = formatOptions(em.options());
+  const string invoker = volumeBackend->describe(em);
+  const string caller = callerLabelForLogging;
+  const ExternalMount mount = em;
+
+  VolumeDriverMetrics& driverMetrics = metrics->driver(em.volumedriver());
+
+  // Only the backend's own time is reported as unmount_ms, the wait
+  // for admission is queue_wait_ms.
+  return admissions->admit<Nothing>(
+      mount.volumedriver(),
+      mount.priority(),
+      driverMetrics,
+      [volumeBackend, mount, &driverMetrics]() {
+        return driverMetrics.unmount.time(volumeBackend->unmount(mount));
+      })
+    .then([invoker]() {
+      LOG(INFO) << invoker << " " << DVDCLI_UNMOUNT_CMD << " succeeded";
+      return true;
+    })
+    .repair([invoker, caller, assumeUnmounted, &driverMetrics](
+        const Future<bool>& result) -> Future<bool> {
+      ++driverMetrics.unmount_failures;
+      if (!assumeUnmounted) {
+        LOG(WARNING) << invoker << " " << DVDCLI_UNMOUNT_CMD
+                     << " failed to execute on " << caller << ": "
+                     << result.failure();
+        return result;
+      }
+      LOG(WARNING) << invoker << " " << DVDCLI_UNMOUNT_CMD
+                   << " failed to execute on " << caller
+                   << ", continuing on the assumption this volume was "
+                   << "manually unmounted previously "
+                   << result.failure();
+      return true;
+    });
+}
 
-  if (system(NULL)) { // Is a command processor available?
-    LOG(INFO) << "Invoking " << em.dvdcli_path()
-              << " " << DVDCLI_MOUNT_CMD << " "
-              << VOL_DRIVER_CMD_OPTION << em.volumedriver() << " "
-              << VOL_NAME_CMD_OPTION << em.volumename() << " "
-              << options;
+void DockerVolumeDriverIsolator::trackMount(
+    const ContainerID&                   containerId,
+    const process::Owned<ExternalMount>& mount)
+{
+  if (infos.track(containerId, mount)) {
+    ++metrics->driver(mount->volumedriver()).mounted;
+  }
 
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-    std::ostringstream cmdOut;
-    Try<int> retcode = os::shell(&cmdOut, "%s %s %s%s %s%s %s %s",
-      em.dvdcli_path().c_str(),
-      DVDCLI_MOUNT_CMD,
-      VOL_DRIVER_CMD_OPTION,
-      em.volumedriver().c_str(),
-      VOL_NAME_CMD_OPTION,
-      em.volumename().c_str(),
-      options.c_str(),
-      (em.explicit_create() ? "--explicitCreate=true" : ""));
-#else
-    Try<string> retcode = os::shell("%s %s %s%s %s%s %s %s",
-      em.dvdcli_path().c_str(),
-      DVDCLI_MOUNT_CMD,
-      VOL_DRIVER_CMD_OPTION,
-      em.volumedriver().c_str(),
-      VOL_NAME_CMD_OPTION,
-      em.volumename().c_str(),
-      options.c_str(),
-      (em.explicit_create() ? "--explicitCreate=true" : ""));
-#endif
+  inventoryUpdated();
+}
 
-    if (retcode.isError()) {
-      LOG(ERROR) << em.dvdcli_path()<< " " << DVDCLI_MOUNT_CMD
-                 << " failed to execute on " << callerLabelForLogging
-                 << retcode.error();
-    } else {
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-      if (retcode.get() != 0) {
-        LOG(ERROR) << em.dvdcli_path() << " " << DVDCLI_MOUNT_CMD
-                   << " returned errorcode " << retcode.get();
-      } else if (strings::trim(cmdOut.str()).empty()) {
-        LOG(ERROR) << em.dvdcli_path() << " " << DVDCLI_MOUNT_CMD
-                   << " returned an empty mountpoint name";
-      } else {
-        mountpoint = strings::trim(cmdOut.str());
-        LOG(INFO) << em.dvdcli_path() << " " << DVDCLI_MOUNT_CMD
-                  << " returned mountpoint:" << mountpoint;
-      }
-#else
-      if (strings::trim(retcode.get()).empty()) {
-        LOG(ERROR) << em.dvdcli_path() << " " << DVDCLI_MOUNT_CMD
-                   << " returned an empty mountpoint name";
-      } else {
-        mountpoint = strings::trim(retcode.get());
-        LOG(INFO) << em.dvdcli_path() << " " << DVDCLI_MOUNT_CMD
-                  << " returned mountpoint:" << mountpoint;
-      }
-#endif
-    }
-  } else {
-    LOG(ERROR) << "Failed to acquire a command processor for unmount on "
-               << callerLabelForLogging;
+std::vector<process::Owned<ExternalMount>>
+DockerVolumeDriverIsolator::untrackContainer(const ContainerID& containerId)
+{
+  std::vector<process::Owned<ExternalMount>> released =
+    infos.untrack(containerId);
+
+  foreach (const process::Owned<ExternalMount>& mount, released) {
+    --metrics->driver(mount->volumedriver()).mounted;
   }
-  return mountpoint;
+
+  inventoryUpdated();
+
+  return released;
 }
 
-bool DockerVolumeDriverIsolator::containsProhibitedChars(
-    const string& s) const
+// Journal record taking the volume off the detach queue.
+static MountJournalRecord unlingered(const ExternalMount& mount)
 {
-  return (string::npos != s.find_first_of(prohibitedchars, 0, NUM_PROHIBITED));
+  ExternalMount lingered = mount;
+  lingered.set_containerid(DVDI_DETACH_CONTAINER_ID);
+  return MountJournal::released(lingered);
 }
 
-bool DockerVolumeDriverIsolator::parseEnvVar(
-  const Environment_Variable&  envvar,
-  const char*                  expectedName,
-  envvararray                  (&insertTarget),
-  bool                         limitCharset) const
+Future<Nothing> DockerVolumeDriverIsolator::journalAdd(
+    const ContainerID&                                containerId,
+    const std::vector<process::Owned<ExternalMount>>& mounts,
+    const std::vector<process::Owned<ExternalMount>>& reclaimed)
 {
-  const size_t prefixLength = strlen(expectedName);
-  if (!strings::startsWith(envvar.name(), expectedName) ||
-      envvar.name().length() > (prefixLength+1) ) {
-    LOG(ERROR) << "Environment variable " << envvar.name()
-               << " rejected because it's name is invalid.";
-    return false;
+  std::vector<MountJournalRecord> records;
+  foreach (const process::Owned<ExternalMount>& mount, mounts) {
+    records.push_back(MountJournal::added(*mount));
   }
-  if (limitCharset && containsProhibitedChars(envvar.value())) {
-    LOG(ERROR) << "Environment variable " << envvar.name()
-               << " rejected because it's value contains "
-               << "prohibited characters";
-    return false;
+  // After the container's own records, so the volume is on record as
+  // mounted throughout.
+  foreach (const process::Owned<ExternalMount>& mount, reclaimed) {
+    records.push_back(unlingered(*mount));
   }
 
-  size_t index = 0;
-  if (envvar.name().length() == (prefixLength+1)) {
-    char digit = envvar.name().data()[prefixLength];
+  // A container whose mounts are not on disk fails prepare(), a crash
+  // would otherwise leave them unknown to recover(). Its mounts are
+  // already tracked, the containerizer's cleanup() releases them.
+  DvdiMetrics* dvdiMetrics = metrics.get();
+  return dvdiMetrics->checkpoint.time(
+      dispatch(journalWriter->self(), &MountJournalWriter::commit, records))
+    .repair([containerId, dvdiMetrics](
+        const Future<Nothing>& commit) -> Future<Nothing> {
+      ++dvdiMetrics->checkpoint_failures;
+      LOG(ERROR) << "Failed to checkpoint mounts of container "
+                 << containerId << ": " << commit.failure();
+      return Failure("prepare() failed to checkpoint the mounts: " +
+                     commit.failure());
+    });
+}
 
-    if (!isdigit(digit)) {
-      LOG(ERROR) << "Environment variable " << envvar.name()
-                 << " rejected because it doesn't end with a digit.";
-      return false;
-    }
-    index = std::atoi(envvar.name().substr(prefixLength).c_str());
+Future<Nothing> DockerVolumeDriverIsolator::journalRemove(
+    const ContainerID&                                containerId,
+    const std::vector<process::Owned<ExternalMount>>& lingered)
+{
+  // Lingering volumes are recorded before the container lets go of them.
+  std::vector<MountJournalRecord> records;
+  foreach (const process::Owned<ExternalMount>& mount, lingered) {
+    records.push_back(MountJournal::added(*mount));
   }
-
-  insertTarget[index] = envvar.value();
-  LOG(INFO) << envvar.name()  << "("
-            << envvar.value() << ") parsed from environment";
-  return true;
+  records.push_back(MountJournal::removed(stringify(containerId)));
+
+  // Unlike journalAdd(), a failed write is only logged: failing
+  // cleanup() would keep the container from being destroyed, and a
+  // stale record errs towards the volumes being mounted, which the next
+  // recover() sorts out.
+  DvdiMetrics* dvdiMetrics = metrics.get();
+  return dvdiMetrics->checkpoint.time(
+      dispatch(journalWriter->self(), &MountJournalWriter::commit, records))
+    .repair([containerId, dvdiMetrics](const Future<Nothing>& commit) {
+      ++dvdiMetrics->checkpoint_failures;
+      LOG(ERROR) << "Failed to checkpoint removal of container "
+                 << containerId << ": " << commit.failure();
+      return Nothing();
+    });
 }
 
-Failure DockerVolumeDriverIsolator::revertMountlist(
-    const char*                                      operation,
-    const std::vector<process::Owned<ExternalMount>> mounts) const
+Future<Nothing> DockerVolumeDriverIsolator::journalQueue(
+    const std::vector<process::Owned<ExternalMount>>& mounts)
 {
-  // Once any mount attempt fails, give up on whole list
-  // and attempt to undo the mounts we already made.
-  LOG(ERROR) << operation << " failed during prepare()";
+  std::vector<MountJournalRecord> records;
+  foreach (const process::Owned<ExternalMount>& mount, mounts) {
+    records.push_back(MountJournal::added(*mount));
+  }
 
-  foreach (const process::Owned<ExternalMount> &unmountme, mounts) {
+  // Fails as journalAdd() does: a pre-attach is only acknowledged once
+  // its TTL would survive a restart. It stays queued in memory.
+  DvdiMetrics* dvdiMetrics = metrics.get();
+  return dvdiMetrics->checkpoint.time(
+      dispatch(journalWriter->self(), &MountJournalWriter::commit, records))
+    .repair([dvdiMetrics](
+        const Future<Nothing>& commit) -> Future<Nothing> {
+      ++dvdiMetrics->checkpoint_failures;
+      LOG(ERROR) << "Failed to checkpoint a queued detach: "
+                 << commit.failure();
+      return Failure("Failed to checkpoint the pre-attach: " +
+                     commit.failure());
+    });
+}
 
-    if (unmount(*unmountme, "prepare()-reverting mounts after failure")) {
-      LOG(ERROR) << "During prepare() of a container requesting multiple "
-                 << "mounts, a " << operation
-                 << " failure occurred after making "
-                 << "at least one mount and a second failure occurred "
-                 << "while attempting to remove the earlier mount(s)";
-      break;
-    }
+Future<Nothing> DockerVolumeDriverIsolator::journalRelease(
+    const std::vector<process::Owned<ExternalMount>>& mounts)
+{
+  std::vector<MountJournalRecord> records;
+  foreach (const process::Owned<ExternalMount>& mount, mounts) {
+    records.push_back(unlingered(*mount));
   }
 
-  return Failure(string("prepare() failed during ") + operation + " attempt");
+  DvdiMetrics* dvdiMetrics = metrics.get();
+  return dvdiMetrics->checkpoint.time(
+      dispatch(journalWriter->self(), &MountJournalWriter::commit, records))
+    .repair([dvdiMetrics](const Future<Nothing>& commit) {
+      ++dvdiMetrics->checkpoint_failures;
+      LOG(ERROR) << "Failed to checkpoint the end of a queued detach: "
+                 << commit.failure();
+      return Nothing();
+    });
 }
 
-// Prepare runs BEFORE a task is started
-// will check if the volume is already mounted and if not,
-// will mount the volume.
+Future<Nothing> DockerVolumeDriverIsolator::compactJournal(
+    const std::vector<process::Owned<ExternalMount>>& orphanMounts)
+{
+  // Create ExternalMountList protobuf message to checkpoint
+  ExternalMountList inUseMountsProtobuf;
+  foreachvalue( const process::Owned<ExternalMount> &mount, infos.all()) {
+    ExternalMount* mountptr = inUseMountsProtobuf.add_mount();
+    mountptr->CopyFrom(*(mount.get()));
+  }
+  foreachvalue (const LingeringMount& lingeringMount, lingering) {
+    inUseMountsProtobuf.add_mount()->CopyFrom(*lingeringMount.mount);
+  }
+  foreach (const process::Owned<ExternalMount> &mount, orphanMounts) {
+    inUseMountsProtobuf.add_mount()->CopyFrom(*mount);
+  }
+
+  return dispatch(
+      journalWriter->self(),
+      &MountJournalWriter::compact,
+      inUseMountsProtobuf)
+    .onFailed([](const string& message) {
+      LOG(ERROR) << "Failed to compact the mount journal: " << message;
+    });
+}
+
+// Unmounts the specified external mount unless an unmount of the same
+// volume is already running, in which case that unmount is shared.
+Future<bool> DockerVolumeDriverIsolator::unmountOnce(
+    const ExternalMount& em,
+    const string&   callerLabelForLogging)
+{
+  const ExternalMountID id = getExternalMountId(em);
+
+  if (pendingUnmounts.contains(id)) {
+    LOG(INFO) << em.volumedriver() << "/" << em.volumename()
+              << " is already being unmounted, " << callerLabelForLogging
+              << " will wait for that unmount";
+    ++metrics->driver(em.volumedriver()).coalesced_unmounts;
+    return pendingUnmounts[id];
+  }
+
+  Future<bool> unmounted = unmount(em, callerLabelForLogging);
+  pendingUnmounts[id] = unmounted;
+
+  unmounted.onAny(defer(isolatorProcess->self(), [=](const Future<bool>&) {
+    if (pendingUnmounts.contains(id) && pendingUnmounts[id] == unmounted) {
+      pendingUnmounts.erase(id);
+    }
+  }));
+
+  return unmounted;
+}
+
+process::Owned<ExternalMount> DockerVolumeDriverIsolator::linger(
+    const ExternalMount& em,
+    const Duration&      duration,
+    bool                 schedule)
+{
+  const ExternalMountID id = getExternalMountId(em);
+  unlinger(id);
+
+  process::Owned<ExternalMount> mount(new ExternalMount(em));
+  mount->set_containerid(DVDI_DETACH_CONTAINER_ID);
+  mount->set_linger_until(Clock::now().secs() + duration.secs());
+  mount->clear_pinned();
+
+  const uint64_t generation = ++lingerGeneration;
+  lingering[id] = LingeringMount{mount, Future<Nothing>(), generation};
+  ++metrics->driver(em.volumedriver()).lingering;
+  inventoryUpdated();
+
+  if (schedule) {
+    scheduleExpire(id);
+  }
+
+  return mount;
+}
+
+void DockerVolumeDriverIsolator::scheduleExpire(const ExternalMountID& id)
+{
+  const uint64_t generation = lingering[id].generation;
+
+  Try<Duration> remaining = Duration::create(
+      lingering[id].mount->linger_until() - Clock::now().secs());
+  const Future<Nothing> timer = process::after(
+      remaining.isSome() && remaining.get() > Duration::zero()
+        ? remaining.get()
+        : Duration::zero());
+
+  lingering[id].timer = timer;
+
+  timer.onReady(defer(isolatorProcess->self(), [=](const Nothing&) {
+    expire(id, generation);
+  }));
+}
+
+bool DockerVolumeDriverIsolator::unlinger(const ExternalMountID& id)
+{
+  if (!lingering.contains(id)) {
+    return false;
+  }
+
+  --metrics->driver(lingering[id].mount->volumedriver()).lingering;
+  lingering[id].timer.discard();
+  lingering.erase(id);
+  inventoryUpdated();
+
+  return true;
+}
+
+void DockerVolumeDriverIsolator::expire(
+    const ExternalMountID& id,
+    uint64_t               generation)
+{
+  if (!lingering.contains(id) || lingering[id].generation != generation) {
+    return;
+  }
+
+  detachLimiter->acquire()
+    .onAny(defer(isolatorProcess->self(), [=](const Future<Nothing>&) {
+      _expire(id, generation);
+    }));
+}
+
+void DockerVolumeDriverIsolator::_expire(
+    const ExternalMountID& id,
+    uint64_t               generation)
+{
+  if (!lingering.contains(id) || lingering[id].generation != generation) {
+    // Taken over while queued.
+    detachLimiter->release();
+    return;
+  }
+
+  const process::Owned<ExternalMount> mount = lingering[id].mount;
+  unlinger(id);
+
+  // A container may have joined a pre-attach's mount before it was
+  // queued, it now owns the volume.
+  if (infos.inUse(id) || pendingMounts.contains(id)) {
+    detachLimiter->release();
+    journalRelease({mount});
+    return;
+  }
+
+  // The queued detach stays on record until the unmount succeeds, so a
+  // crash in between leaves it to recover().
+  const std::shared_ptr<ConcurrencyLimiter> limiter = detachLimiter;
+  unmountOnce(*mount, "cleanup()")
+    .onAny([limiter]() { limiter->release(); })
+    .onAny(defer(isolatorProcess->self(), [=](const Future<bool>& unmounted) {
+      if (unmounted.isReady() && unmounted.get()) {
+        journalRelease({mount});
+      } else {
+        LOG(ERROR) << "Failed to unmount " << mount->volumedriver() << "/"
+                   << mount->volumename() << " in the background, "
+                   << "it is left to the next recovery";
+      }
+    }));
+}
+
+// Attempts to mount specified external mount,
+// returned future holds the non-empty mountpoint on success.
+Future<string> DockerVolumeDriverIsolator::mount(
+    const ExternalMount& em,
+    const string&   callerLabelForLogging) const
+{
+  LOG(INFO) << em.volumedriver() << "/" << em.volumename()
+            << " is being mounted on "
+            << callerLabelForLogging;
+
+  const std::shared_ptr<VolumeBackend> volumeBackend = backend(em);
+
+  Option<string> unavailable = volumeBackend->unavailable(em);
+  if (unavailable.isSome()) {
+    LOG(ERROR) << unavailable.get();
+    return Failure(unavailable.get());
+  }
+
+  const string invoker = volumeBackend->describe(em);
+  const string caller = callerLabelForLogging;
+  const ExternalMount mount = em;
+
+  VolumeDriverMetrics& driverMetrics = metrics->driver(em.volumedriver());
+
+  return admissions->admit<string>(
+      mount.volumedriver(),
+      mount.priority(),
+      driverMetrics,
+      [volumeBackend, mount, &driverMetrics]() {
+        return driverMetrics.mount.time(volumeBackend->mount(mount));
+      })
+    .then([invoker](const string& mountpoint) -> Future<string> {
+      if (mountpoint.empty()) {
+        LOG(ERROR) << invoker << " " << DVDCLI_MOUNT_CMD
+                   << " returned an empty mountpoint name";
+        return Failure(invoker + " returned an empty mountpoint name");
+      }
+
+      LOG(INFO) << invoker << " " << DVDCLI_MOUNT_CMD
+                << " returned mountpoint:" << mountpoint;
+      return mountpoint;
+    })
+    .onFailed([invoker, caller, &driverMetrics](const string& message) {
+      ++driverMetrics.mount_failures;
+      LOG(ERROR) << invoker << " " << DVDCLI_MOUNT_CMD
+                 << " failed to execute on " << caller << ": " << message;
+    });
+}
+
+bool DockerVolumeDriverIsolator::containsProhibitedChars(
+    const string& s)
+{
+  return (string::npos != s.find_first_of(prohibitedchars, 0, NUM_PROHIBITED));
+}
+
+// The fields of a VolumeSpec, each set by DVDI_VOLUME_<FIELD><n>.
+// In DVDI_VOLUMES a field's key is <field> in lower case, e.g.
+// "containerpath".
+struct VolumeSpecField
+{
+  const char* name;
+  std::string DockerVolumeDriverIsolator::VolumeSpec::*member;
+  // Whether the value is checked for prohibited characters.
+  bool limitCharset;
+};
+
+static const VolumeSpecField VOLUME_SPEC_FIELDS[] = {
+  {VOL_NAME_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::name, true},
+  {VOL_DRIVER_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::driver, true},
+  {VOL_OPTS_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::options, true},
+  {VOL_CPATH_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::containerPath, false},
+  {VOL_DVDCLI_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::dvdcliPath, false},
+  {VOL_EXPLICIT_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::explicitCreate, true},
+  {VOL_BACKEND_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::backend, true},
+  {VOL_MODE_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::mode, true},
+  {VOL_PRIORITY_ENV_VAR_NAME,
+   &DockerVolumeDriverIsolator::VolumeSpec::priority, true},
+};
+
+// VOLUME_SPEC_FIELDS keyed by variable name without its number, and by
+// DVDI_VOLUMES key.
+static const hashmap<string, const VolumeSpecField*>& volumeSpecFields()
+{
+  static const hashmap<string, const VolumeSpecField*> fields = []() {
+    hashmap<string, const VolumeSpecField*> fields;
+    foreach (const VolumeSpecField& field, VOLUME_SPEC_FIELDS) {
+      fields[field.name] = &field;
+      fields[strings::lower(
+          string(field.name).substr(strlen(VOL_ENV_VAR_PREFIX)))] = &field;
+    }
+    return fields;
+  }();
+  return fields;
+}
+
+static Try<Nothing> setVolumeSpecField(
+    DockerVolumeDriverIsolator::VolumeSpec* spec,
+    const VolumeSpecField& field,
+    const string& name,
+    const string& value)
+{
+  if (field.limitCharset &&
+      DockerVolumeDriverIsolator::containsProhibitedChars(value)) {
+    return Error("Environment variable " + name + " rejected because its "
+                 "value contains prohibited characters");
+  }
+
+  spec->*field.member = value;
+  return Nothing();
+}
+
+// Adds the volumes listed in DVDI_VOLUMES, a JSON array of objects such
+// as {"name": "data", "containerpath": "/data"}.
+static Try<Nothing> parseVolumesVariable(
+    const string& value,
+    std::vector<DockerVolumeDriverIsolator::VolumeSpec>* specs)
+{
+  Try<JSON::Array> array = JSON::parse<JSON::Array>(value);
+  if (array.isError()) {
+    return Error(string(VOLS_ENV_VAR_NAME) + " is not a JSON array: " +
+                 array.error());
+  }
+
+  foreach (const JSON::Value& element, array.get().values) {
+    if (!element.is<JSON::Object>()) {
+      return Error(string(VOLS_ENV_VAR_NAME) + " must only list objects");
+    }
+
+    DockerVolumeDriverIsolator::VolumeSpec spec;
+    foreachpair (const string& key,
+                 const JSON::Value& field,
+                 element.as<JSON::Object>().values) {
+      Option<const VolumeSpecField*> known = volumeSpecFields().get(key);
+      if (known.isNone() || key != strings::lower(key)) {
+        return Error("Unknown field '" + key + "' in " + VOLS_ENV_VAR_NAME);
+      }
+
+      // Strings are taken as they are, anything else, e.g. true, as
+      // written.
+      const string text = field.is<JSON::String>()
+        ? field.as<JSON::String>().value
+        : stringify(field);
+
+      Try<Nothing> set = setVolumeSpecField(
+          &spec, *known.get(), VOLS_ENV_VAR_NAME, text);
+      if (set.isError()) {
+        return set;
+      }
+    }
+
+    if (spec.name.empty()) {
+      return Error(string(VOLS_ENV_VAR_NAME) + " lists a volume without " +
+                   "a name");
+    }
+    specs->push_back(spec);
+  }
+
+  return Nothing();
+}
+
+// Where the number of DVDI_VOLUME_<FIELD><n> starts, the size of the
+// name if it has none.
+static size_t volumeNumberStart(const string& name)
+{
+  size_t digits = name.size();
+  while (digits > 0 && isdigit(name[digits - 1])) {
+    digits--;
+  }
+  return digits;
+}
+
+Try<std::vector<DockerVolumeDriverIsolator::VolumeSpec>>
+DockerVolumeDriverIsolator::parseVolumeSpecs(const Environment& environment)
+{
+  // Keyed by the variables' number, no number being 0, so volumes are
+  // listed in order whatever the order of the variables.
+  std::map<uint64_t, VolumeSpec> numbered;
+  std::vector<VolumeSpec> listed;
+
+  // The first variable seen with each number, whose spelling of the
+  // number every other variable of that volume must share.
+  hashmap<uint64_t, string> numberedBy;
+
+  foreach (const Environment_Variable& variable, environment.variables()) {
+    const string& name = variable.name();
+
+    if (name == VOLS_ENV_VAR_NAME) {
+      Try<Nothing> parsed = parseVolumesVariable(variable.value(), &listed);
+      if (parsed.isError()) {
+        return Error(parsed.error());
+      }
+      continue;
+    }
+
+    if (!strings::startsWith(name, VOL_ENV_VAR_PREFIX)) {
+      continue;
+    }
+
+    // DVDI_VOLUME_<FIELD><n>, where n is any number of digits.
+    const size_t digits = volumeNumberStart(name);
+
+    Option<const VolumeSpecField*> field =
+      volumeSpecFields().get(name.substr(0, digits));
+    if (field.isNone()) {
+      // A known field followed by something other than a number.
+      foreach (const VolumeSpecField& known, VOLUME_SPEC_FIELDS) {
+        if (strings::startsWith(name, known.name)) {
+          return Error("Environment variable " + name + " rejected " +
+                       "because it doesn't end with a number");
+        }
+      }
+      continue;
+    }
+
+    uint64_t index = 0;
+    if (digits < name.size()) {
+      Try<uint64_t> number = numify<uint64_t>(name.substr(digits));
+      if (number.isError()) {
+        return Error("Environment variable " + name + " rejected " +
+                     "because its number is invalid");
+      }
+      index = number.get();
+    }
+
+    // DVDI_VOLUME_NAME01 and DVDI_VOLUME_NAME1 would silently configure
+    // the same volume.
+    if (!numberedBy.contains(index)) {
+      numberedBy[index] = name;
+    } else {
+      const string& first = numberedBy.at(index);
+      if (first.substr(volumeNumberStart(first)) != name.substr(digits)) {
+        return Error("Environment variables " + first + " and " + name +
+                     " rejected because they number the same volume " +
+                     "differently");
+      }
+    }
+
+    Try<Nothing> set = setVolumeSpecField(
+        &numbered[index], *field.get(), name, variable.value());
+    if (set.isError()) {
+      return Error(set.error());
+    }
+
+    LOG(INFO) << name << "(" << variable.value()
+              << ") parsed from environment";
+  }
+
+  std::vector<VolumeSpec> specs;
+  foreachvalue (const VolumeSpec& spec, numbered) {
+    if (!spec.name.empty()) {
+      specs.push_back(spec);
+    }
+  }
+  specs.insert(specs.end(), listed.begin(), listed.end());
+
+  return specs;
+}
+
+Failure DockerVolumeDriverIsolator::revertMountlist(
+    const char*                                      operation,
+    const std::vector<process::Owned<ExternalMount>> mounts)
+{
+  // Once any mount attempt fails, give up on whole list
+  // and attempt to undo the mounts we already made.
+  LOG(ERROR) << operation << " failed during prepare()";
+
+  const string failedOperation = operation;
+  std::vector<process::Owned<ExternalMount>> reverted;
+  foreach (const process::Owned<ExternalMount> &unmountme, mounts) {
+    const ExternalMountID id = getExternalMountId(*unmountme);
+
+    // Another prepare() may have joined this mount while it was pending,
+    // or another container may be using it, in which case it stays.
+    if (infos.inUse(id) || pendingMounts.contains(id)) {
+      LOG(INFO) << unmountme->volumedriver() << "/" << unmountme->volumename()
+                << " is wanted by another container and will not be reverted";
+      continue;
+    }
+
+    unlinger(id);
+    reverted.push_back(unmountme);
+    unmountOnce(*unmountme, "prepare()-reverting mounts after failure")
+      .onAny([failedOperation](const Future<bool>& unmounted) {
+        if (!unmounted.isReady() || !unmounted.get()) {
+          LOG(ERROR) << "During prepare() of a container requesting multiple "
+                     << "mounts, a " << failedOperation
+                     << " failure occurred after making "
+                     << "at least one mount and a second failure occurred "
+                     << "while attempting to remove the earlier mount(s)";
+        }
+      });
+  }
+
+  // Some of the mounts may have been taken over from the detach queue,
+  // they leave it for good. Releasing one that was not is a no-op.
+  if (!reverted.empty()) {
+    journalRelease(reverted);
+  }
+
+  return Failure(string("prepare() failed during ") + operation + " attempt");
+}
+
+// Prepare runs BEFORE a task is started
+// will check if the volume is already mounted and if not,
+// will mount the volume.
 // A container can ask for multiple mounts, but if
 // there are any problems parsing or mounting even one
 // mount, we want to exit with an error and no new
@@ -599,10 +1621,6 @@ Future<Option<ContainerLaunchInfo>> DockerVolumeDriverIsolator::prepare(
   LOG(INFO) << "Preparing external storage for container: "
             << stringify(containerId);
 
-  if (infos.contains(containerId)) {
-    return Failure("Container has already been prepared");
-  }
-
 #if MESOS_VERSION_INT < 200 || MESOS_VERSION_INT >= 280
   const ExecutorInfo& executorInfo = containerConfig.executor_info();
 #elif MESOS_VERSION_INT >= 270
@@ -617,114 +1635,74 @@ Future<Option<ContainerLaunchInfo>> DockerVolumeDriverIsolator::prepare(
     return None();
   }
 
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-  list<string> commands;
-#elif MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 250
-  ContainerPrepareInfo prepareInfo;
-#elif MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 270
-  ContainerPrepareInfo prepareInfo;
-  prepareInfo.set_namespaces(CLONE_NEWNS);
-#elif MESOS_VERSION_INT >= 120 && MESOS_VERSION_INT < 130
-  // This makes this file compatible with the changes for Mesos v1.2.0
-  ContainerLaunchInfo prepareInfo;
-  prepareInfo.add_clone_namespaces(CLONE_NEWNS);
-#else
-  //yes, this should be called launchInfo, but it side step making a lot of
-  //code changes.
-  ContainerLaunchInfo prepareInfo;
-  prepareInfo.set_namespaces(CLONE_NEWNS);
-#endif
-
-  // We accept <environment-var-name>#, where # can be 1-9, saved in array[#].
-  // We also accept <environment-var-name>, saved in array[0].
-  // parsing is "messy" because we don't insist that environment
-  // variable are in any particular order, or grouped by volume #
-  envvararray deviceDriverNames;
-  envvararray volumeNames;
-  envvararray mountOptions;
-  envvararray containerPaths;
-  envvararray dvdcliPaths;
-  envvararray explicitCreates;
-
-  // Iterate through the environment variables,
-  // looking for the ones we need.
-  foreach (const Environment_Variable &variable,
-           executorInfo.command().environment().variables()) {
-
-    if (strings::startsWith(variable.name(), VOL_NAME_ENV_VAR_NAME)) {
-      if (!parseEnvVar(variable, VOL_NAME_ENV_VAR_NAME, volumeNames, true)) {
-        return Failure("prepare() failed due to illegal VOL_NAME_ENV_VAR_NAME");
-      }
-    } else if (strings::startsWith(variable.name(), VOL_DRIVER_ENV_VAR_NAME)) {
-      if (!parseEnvVar(
-          variable,
-          VOL_DRIVER_ENV_VAR_NAME,
-          deviceDriverNames,
-          true)) {
-        return Failure("prepare() failed due to illegal VOL_DRIVER_ENV_VAR_NAME");
-      }
-    } else if (strings::startsWith(variable.name(), VOL_OPTS_ENV_VAR_NAME)) {
-      if (!parseEnvVar(variable, VOL_OPTS_ENV_VAR_NAME, mountOptions, true)) {
-        return Failure("prepare() failed due to illegal VOL_OPTS_ENV_VAR_NAME");
-      }
-    } else if (strings::startsWith(variable.name(), VOL_CPATH_ENV_VAR_NAME)) {
-      if (!parseEnvVar(
-          variable,
-          VOL_CPATH_ENV_VAR_NAME,
-          containerPaths,
-          false)) {
-        return Failure("prepare() failed due to illegal VOL_CPATH_ENV_VAR_NAME");
-      }
-    } else if (strings::startsWith(variable.name(), VOL_DVDCLI_ENV_VAR_NAME)) {
-      if (!parseEnvVar(variable, VOL_DVDCLI_ENV_VAR_NAME, dvdcliPaths, false)) {
-        return Failure("prepare() failed due to illegal VOL_DVDCLI_ENV_VAR_NAME");
-      }
-    } else if (strings::startsWith(variable.name(), VOL_EXPLICIT_ENV_VAR_NAME)) {
-      if (!parseEnvVar(variable, VOL_EXPLICIT_ENV_VAR_NAME, explicitCreates, true)) {
-        return Failure("prepare() failed due to illegal VOL_EXPLICIT_ENV_VAR_NAME");
-      }
-    }
+  Try<std::vector<VolumeSpec>> specs =
+    parseVolumeSpecs(executorInfo.command().environment());
+  if (specs.isError()) {
+    return Failure("prepare() failed, " + specs.error());
   }
 
   // requestedExternalMounts is all mounts requested by container.
   std::vector<process::Owned<ExternalMount>> requestedExternalMounts;
+  hashset<ExternalMountID> requestedIds;
 
-  // unconnectedExternalMounts is the subset of those not already
-  // in use by another container.
-  std::vector<process::Owned<ExternalMount>> unconnectedExternalMounts;
-
-  // prevConnectedExternalMounts is the subset of those that are
-  // in use by another container.
-  std::vector<process::Owned<ExternalMount>> prevConnectedExternalMounts;
-
-  // Not using iterator because we access all 4 arrays using common index.
-  for (size_t i = 0; i < volumeNames.size(); i++) {
+  foreach (VolumeSpec spec, specs.get()) {
+    LOG(INFO) << "Validating mount name " << spec.name;
 
-    if (volumeNames[i].empty()) {
-      continue;
+    if (spec.driver.empty()) {
+      spec.driver = VOL_DRIVER_DEFAULT;
+    }
+    if (spec.dvdcliPath.empty()) {
+      spec.dvdcliPath = DEFAULT_DVDCLI_BIN;
+    }
+    if (spec.explicitCreate.empty()) {
+      spec.explicitCreate = "false";
+    }
+    if (spec.backend.empty()) {
+      spec.backend = defaultBackend;
+    } else if (!backends.contains(spec.backend)) {
+      return Failure(
+        "prepare() failed, unknown volume backend " + spec.backend);
     }
 
-    LOG(INFO) << "Validating mount name " << volumeNames[i];
+    const string mode = strings::lower(strings::trim(spec.mode));
+    if (!mode.empty() && mode != "ro" && mode != "rw") {
+      return Failure("prepare() failed, mode of " + spec.name +
+                     " must be ro or rw, not " + spec.mode);
+    }
+    if (mode == "ro" && spec.containerPath.empty()) {
+      return Failure("prepare() failed, read-only volume " + spec.name +
+                     " has no containerpath to bind mount");
+    }
 
-    if (deviceDriverNames[i].empty()) {
-      deviceDriverNames[i] = VOL_DRIVER_DEFAULT;
+    int priority = 0;
+    if (!strings::trim(spec.priority).empty()) {
+      Try<int> parsed = numify<int>(strings::trim(spec.priority));
+      if (parsed.isError()) {
+        return Failure("prepare() failed, priority of " + spec.name +
+                       " must be an integer, not " + spec.priority);
+      }
+      priority = parsed.get();
     }
-    if (dvdcliPaths[i].empty()) {
-      dvdcliPaths[i] = DEFAULT_DVDCLI_BIN;
+
+    Try<Option<IoThrottle>> throttle = extractThrottle(&spec.options);
+    if (throttle.isError()) {
+      return Failure("prepare() failed, " + throttle.error());
     }
-    if (explicitCreates[i].empty()) {
-      explicitCreates[i] = "false";
+    if (throttle.get().isSome() && blkioHierarchy.isNone()) {
+      return Failure("prepare() failed, volume I/O cannot be throttled on "
+                     "this agent, " + string(DVDI_IOTHROTTLING_PARAM_NAME) +
+                     " is off");
     }
 
     // TODO consider not filling container path if it is empty.
     // Empty container path would mean leaving do not engage isolation on mount
     // resulting in mount exposure across all containers.
-    if (!containerPaths[i].empty()) {
-      if (!strings::startsWith(containerPaths[i], "/")) {
+    if (!spec.containerPath.empty()) {
+      if (!strings::startsWith(spec.containerPath, "/")) {
         return Failure("prepare() failed, containerpaths must start with /");
       }
-      if (!os::exists(containerPaths[i]) &&
-          !strings::startsWith(containerPaths[i], "/tmp/")) {
+      if (!os::exists(spec.containerPath) &&
+          !strings::startsWith(spec.containerPath, "/tmp/")) {
         return Failure(
           "prepare() failed, containerpaths must pre-exist, or be under /tmp");
       }
@@ -733,31 +1711,27 @@ Future<Option<ContainerLaunchInfo>> DockerVolumeDriverIsolator::prepare(
     // note: mountpoint is not set yet, because we haven't mounted yet
     process::Owned<ExternalMount> requestedMount(
       Builder().setContainerId(stringify(containerId))
-               .setVolumeDriver(deviceDriverNames[i])
-               .setVolumeName(volumeNames[i])
-               .setOptions(mountOptions[i])
-               .setContainerPath(containerPaths[i])
-               .setDvdcliPath(dvdcliPaths[i])
+               .setVolumeDriver(spec.driver)
+               .setVolumeName(spec.name)
+               .setOptions(spec.options)
+               .setContainerPath(spec.containerPath)
+               .setDvdcliPath(spec.dvdcliPath)
                .setExplicitCreate(
-                 (strings::lower(strings::trim(explicitCreates[i])).compare("true")==0)
+                 (strings::lower(strings::trim(spec.explicitCreate)).compare("true")==0)
                )
+               .setBackend(spec.backend)
+               .setReadOnly(mode == "ro")
+               .setPriority(priority)
                .build()
       );
-
-    // Check for duplicates in environment.
-    bool duplicateInEnv = false;
-    foreach (const process::Owned<ExternalMount> &mount,
-             requestedExternalMounts) {
-
-      if (getExternalMountId(*(mount.get())) ==
-              getExternalMountId(*(requestedMount.get())) ) {
-        duplicateInEnv = true;
-        break;
-      }
+    if (throttle.get().isSome()) {
+      requestedMount->mutable_throttle()->CopyFrom(throttle.get().get());
     }
 
-    if (duplicateInEnv) {
-      if (!containerPaths[i].empty()) {
+    // Check for duplicates in environment.
+    const ExternalMountID requestedId = getExternalMountId(*requestedMount);
+    if (requestedIds.contains(requestedId)) {
+      if (!spec.containerPath.empty()) {
         return Failure("prepare() failed, duplicated mount with containerpath");
       }
       LOG(INFO) << "Duplicate mount request("
@@ -767,77 +1741,225 @@ Future<Option<ContainerLaunchInfo>> DockerVolumeDriverIsolator::prepare(
       continue;
     }
 
+    requestedIds.insert(requestedId);
     requestedExternalMounts.push_back(requestedMount);
+  }
 
-    // Now check if another container is already using this same mount.
-    bool mountInUse = false;
-    foreachvalue (const process::Owned<ExternalMount> &mount, infos) {
-
-      if (getExternalMountId(*(mount.get())) ==
-            getExternalMountId(*(requestedMount.get())) ) {
-        mountInUse = true;
-        requestedMount->set_mountpoint(mount->mountpoint());
-        prevConnectedExternalMounts.push_back(requestedMount);
-        LOG(INFO) << "Requested mount(" << requestedMount->volumedriver() << "/"
-                  << requestedMount->volumename()
-                  << ") is already mounted by another container";
-        if (!containerPaths[i].empty()) {
-          return Failure(
-                  "prepare() failed, containerpath request on existing mount");
-        }
-        break;
-      }
+  // Everything from here on reads or modifies infos,
+  // so it is serialized on the isolator actor.
+  const std::function<Future<Nothing>()> attachMounts =
+    [=]() { return attach(containerId, requestedExternalMounts); };
+
+  // The volumes are bind mounted into the container by isolate(), the
+  // launcher has nothing to run for them.
+  return dispatch(isolatorProcess->self(), attachMounts)
+    .then([]() -> Future<PrepareInfo> {
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+      return PrepareInfo(None());
+#else
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 250
+      ContainerPrepareInfo prepareInfo;
+#elif MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 270
+      ContainerPrepareInfo prepareInfo;
+      prepareInfo.set_namespaces(CLONE_NEWNS);
+#elif MESOS_VERSION_INT >= 120 && MESOS_VERSION_INT < 130
+      // This makes this file compatible with the changes for Mesos v1.2.0
+      ContainerLaunchInfo prepareInfo;
+      prepareInfo.add_clone_namespaces(CLONE_NEWNS);
+#else
+      //yes, this should be called launchInfo, but it side step making a lot
+      //of code changes.
+      ContainerLaunchInfo prepareInfo;
+      prepareInfo.set_namespaces(CLONE_NEWNS);
+#endif
+
+      return prepareInfo;
+#endif
+    });
+}
+
+Future<Nothing> DockerVolumeDriverIsolator::attach(
+    const ContainerID& containerId,
+    const std::vector<process::Owned<ExternalMount>> requestedMounts)
+{
+  if (infos.contains(containerId)) {
+    return Failure("Container has already been prepared");
+  }
+
+  std::vector<ExternalMountID> ids;
+  foreach (const process::Owned<ExternalMount> &requestedMount,
+           requestedMounts) {
+    ids.push_back(getExternalMountId(*requestedMount));
+  }
+
+  // First pass only validates, so a failure here leaves no trace.
+  for (size_t i = 0; i < requestedMounts.size(); i++) {
+    const process::Owned<ExternalMount>& requestedMount = requestedMounts[i];
+    const string& containerPath = requestedMount->container_path();
+    const ExternalMountID& id = ids[i];
+
+    // Another container already using, or in the middle of mounting,
+    // this same volume is fine: every container gets its own bind
+    // mount of the shared mountpoint in isolate().
+    if (infos.inUse(id) || pendingMounts.contains(id)) {
+      LOG(INFO) << "Requested mount(" << requestedMount->volumedriver() << "/"
+                << requestedMount->volumename()
+                << ") is already mounted by another container";
     }
 
-    if (!mountInUse) {
-      unconnectedExternalMounts.push_back(requestedMount);
-      if (!containerPaths[i].empty() &&
-          !os::exists(containerPaths[i])) {
-        Try<Nothing> mkdir = os::mkdir(containerPaths[i]);
-        if (mkdir.isError()) {
-          return Failure(
-            "DockerVolumeDriverIsolator could not create container path dir: " +
-            containerPaths[i]);
-        }
+    if (!containerPath.empty() && !os::exists(containerPath)) {
+      Try<Nothing> mkdir = os::mkdir(containerPath);
+      if (mkdir.isError()) {
+        return Failure(
+          "DockerVolumeDriverIsolator could not create container path dir: " +
+          containerPath);
       }
     }
-
   }
 
-  // As we connect mounts we will build a list of successful mounts.
-  // We need this because, if there is a failure, we need to unmount these.
-  // The goal is we mount either ALL or NONE.
-  std::vector<process::Owned<ExternalMount>> successfulExternalMounts;
-  foreach (const process::Owned<ExternalMount> &newMount,
-           unconnectedExternalMounts) {
-    string mountpoint = mount(*newMount, "prepare()");
+  // Second pass registers this container as a waiter on every volume.
+  // A volume that is already mounted, or being mounted for another
+  // container, is shared rather than mounted a second time.
+  // newlyMounted[i] is true where this container issued the dvdcli mount
+  // or took the volume over from the detach queue.
+  std::vector<bool> newlyMounted;
+  std::vector<process::Owned<ExternalMount>> reclaimed;
+  list<Future<string>> mountpoints;
+
+  for (size_t i = 0; i < requestedMounts.size(); i++) {
+    const process::Owned<ExternalMount>& requestedMount = requestedMounts[i];
+    const ExternalMountID& id = ids[i];
+
+    if (pendingMounts.contains(id)) {
+      LOG(INFO) << "Joining pending mount of "
+                << requestedMount->volumedriver() << "/"
+                << requestedMount->volumename();
+      pendingMounts[id].waiters++;
+      ++metrics->driver(requestedMount->volumedriver()).coalesced_mounts;
+      newlyMounted.push_back(false);
+      mountpoints.push_back(pendingMounts[id].mountpoint);
+      continue;
+    }
 
-    if (!mountpoint.empty()) {
-      // Need to construct a newExternalMount because we just
-      // learned the mountpoint.
-      newMount->set_mountpoint(mountpoint);
-      successfulExternalMounts.push_back(newMount);
+    const Option<string> existing = infos.mountpoint(id);
+
+    Future<string> mountpoint;
+    if (existing.isSome()) {
+      mountpoint = existing.get();
+    } else if (lingering.contains(id)) {
+      LOG(INFO) << "Reusing " << requestedMount->volumedriver() << "/"
+                << requestedMount->volumename()
+                << ", still mounted while queued for detach";
+      VolumeDriverMetrics& driverMetrics =
+        metrics->driver(requestedMount->volumedriver());
+      ++driverMetrics.reused_mounts;
+
+      mountpoint = lingering[id].mount->mountpoint();
+      requestedMount->set_attached_at(lingering[id].mount->attached_at());
+      unlinger(id);
+      reclaimed.push_back(requestedMount);
+    } else if (pendingUnmounts.contains(id)) {
+      // Mounting while the previous user's unmount is still running
+      // would race inside the volume driver, so wait for it first.
+      LOG(INFO) << "Waiting for pending unmount of "
+                << requestedMount->volumedriver() << "/"
+                << requestedMount->volumename() << " before mounting";
+      mountpoint = pendingUnmounts[id]
+        .then(defer(isolatorProcess->self(), [=](bool) {
+          return mount(*requestedMount, "prepare()");
+        }));
     } else {
-      // Once any mount attempt fails, give up on whole list
-      // and attempt to undo the mounts we already made.
-      return revertMountlist("mount",successfulExternalMounts);
+      mountpoint = mount(*requestedMount, "prepare()");
     }
+
+    pendingMounts[id] = PendingMount{mountpoint, 1};
+    newlyMounted.push_back(existing.isNone());
+    mountpoints.push_back(mountpoint);
   }
 
-  foreach (const process::Owned<ExternalMount> &prevMount,
-           prevConnectedExternalMounts) {
+  // All new mounts are started at once, the agent wide and per driver
+  // limits on concurrent invocations are enforced inside mount().
+  return await(mountpoints)
+    .then(defer(isolatorProcess->self(), [=](
+        const list<Future<string>>& results) -> Future<Nothing> {
+      // As we connect mounts we will build a list of successful mounts.
+      // We need this because, if there is a failure, we need to unmount
+      // these. The goal is we mount either ALL or NONE.
+      std::vector<process::Owned<ExternalMount>> successfulExternalMounts;
+
+      // prevConnectedExternalMounts is the subset of those that are
+      // in use by another container.
+      std::vector<process::Owned<ExternalMount>> prevConnectedExternalMounts;
+      bool failed = false;
+
+      size_t i = 0;
+      foreach (const Future<string>& mountpoint, results) {
+        const process::Owned<ExternalMount>& requestedMount =
+          requestedMounts[i];
+
+        // This container no longer waits on the pending mount.
+        if (--pendingMounts[ids[i]].waiters == 0) {
+          pendingMounts.erase(ids[i]);
+        }
 
-    LOG(INFO) << "mount " << prevMount->mountpoint()
-              << " was previously connected";
-    // Note: infos has a record for each mount associated with this container
-    // even if the mount is also used by another container.
-    infos.put(containerId, prevMount);
-  }
+        if (mountpoint.isReady()) {
+          // Need to update requestedMount because we just learned the
+          // mountpoint.
+          requestedMount->set_mountpoint(mountpoint.get());
+          if (newlyMounted[i]) {
+            if (!requestedMount->has_attached_at()) {
+              requestedMount->set_attached_at(Clock::now().secs());
+            }
+            successfulExternalMounts.push_back(requestedMount);
+
+            // Reverted with the others, the driver may still hold the
+            // volume attached.
+            if (!confirmMounted(*requestedMount)) {
+              LOG(ERROR) << requestedMount->volumedriver() << "/"
+                         << requestedMount->volumename()
+                         << " was reported mounted at "
+                         << requestedMount->mountpoint()
+                         << " but nothing is mounted there";
+              failed = true;
+            }
+          } else {
+            prevConnectedExternalMounts.push_back(requestedMount);
+          }
+        } else {
+          failed = true;
+        }
+        ++i;
+      }
 
-  foreach (const process::Owned<ExternalMount> &newMount,
-         successfulExternalMounts) {
-    infos.put(containerId, newMount);
+      if (failed) {
+        // Once any mount attempt fails, give up on whole list
+        // and undo the mounts that did succeed, in parallel.
+        // Shared mounts are included, they are only unmounted if no
+        // other container has started using them in the meantime.
+        std::vector<process::Owned<ExternalMount>> revert =
+          successfulExternalMounts;
+        revert.insert(
+            revert.end(),
+            prevConnectedExternalMounts.begin(),
+            prevConnectedExternalMounts.end());
+        return revertMountlist("mount", revert);
+      }
 
+      return _attach(
+          containerId,
+          prevConnectedExternalMounts,
+          successfulExternalMounts,
+          reclaimed);
+    }));
+}
+
+Future<Nothing> DockerVolumeDriverIsolator::_attach(
+    const ContainerID& containerId,
+    const std::vector<process::Owned<ExternalMount>> prevConnectedMounts,
+    const std::vector<process::Owned<ExternalMount>> newMounts,
+    const std::vector<process::Owned<ExternalMount>> reclaimedMounts)
+{
+  foreach (const process::Owned<ExternalMount> &newMount, newMounts) {
     if (newMount->container_path().empty()) {
       continue; // empty container path means skip containerization
     }
@@ -846,61 +1968,51 @@ Future<Option<ContainerLaunchInfo>> DockerVolumeDriverIsolator::prepare(
     string mountPoint = newMount->mountpoint();
 
     // Set the ownership and permissions to match the container path
-    // as these are inherited from host path on bind mount.
+    // as these are inherited from host path on bind mount. Containers
+    // joining the volume later share the first one's.
     struct stat stat;
     if (::stat(containerPath.c_str(), &stat) < 0) {
       LOG(ERROR) << "Failed to get permissions on " << containerPath
                  << " stat returned " << strerror(errno);
-      return revertMountlist("stat",successfulExternalMounts);
+      return revertMountlist("stat", newMounts);
     }
 
     Try<Nothing> chmod = os::chmod(mountPoint, stat.st_mode);
     if (chmod.isError()) {
       LOG(ERROR) << "Failed to get permissions on " << containerPath
                  << " chmod returned " << chmod.error();
-      return revertMountlist("chmod",successfulExternalMounts);
+      return revertMountlist("chmod", newMounts);
     }
 
     Try<Nothing> chown = os::chown(stat.st_uid, stat.st_gid, mountPoint, false);
     if (chown.isError()) {
       LOG(ERROR) << "Failed to get permissions on " << containerPath
                  << " chown returned " << chown.error();
-      return revertMountlist("chown",successfulExternalMounts);
+      return revertMountlist("chown", newMounts);
     }
+  }
 
-    LOG(INFO) << "queueing mount -n --rbind " << mountPoint
-              << " " << containerPath;
+  foreach (const process::Owned<ExternalMount> &prevMount,
+           prevConnectedMounts) {
 
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-    // -n means don't write to /etc/mtab
-    commands.push_back(
-            "mount -n --rbind " + mountPoint + " " + containerPath);
-#elif MESOS_VERSION_INT <= 200
-    prepareInfo.add_pre_exec_commands()->set_value(
-        "mount -n --rbind " + mountPoint + " " + containerPath);
-#else
-    prepareInfo.add_commands()->set_value(
-            "mount -n --rbind " + mountPoint + " " + containerPath);
-#endif
+    LOG(INFO) << "mount " << prevMount->mountpoint()
+              << " was previously connected";
+    // Note: infos has a record for each mount associated with this container
+    // even if the mount is also used by another container.
+    trackMount(containerId, prevMount);
   }
 
-  // Create ExternalMountList protobuf message to checkpoint
-  ExternalMountList inUseMountsProtobuf;
-  foreachvalue( const process::Owned<ExternalMount> &mount, infos) {
-    ExternalMount* mountptr = inUseMountsProtobuf.add_mount();
-    mountptr->CopyFrom(*(mount.get()));
+  foreach (const process::Owned<ExternalMount> &newMount, newMounts) {
+    trackMount(containerId, newMount);
   }
-  mesos::internal::slave::state::checkpoint(mountPbFilename,
-    inUseMountsProtobuf);
 
-#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
-  CommandInfo command;
-  command.set_value(strings::join(" && ", commands));
+  std::vector<process::Owned<ExternalMount>> containerMounts =
+    prevConnectedMounts;
+  containerMounts.insert(
+      containerMounts.end(), newMounts.begin(), newMounts.end());
 
-  return command;
-#else
-  return prepareInfo;
-#endif
+  // The container is only reported prepared once its mounts are durable.
+  return journalAdd(containerId, containerMounts, reclaimedMounts);
 }
 
 #if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
@@ -925,81 +2037,579 @@ Future<Nothing> DockerVolumeDriverIsolator::update(
     const ContainerID& containerId,
     const Resources& resources)
 {
-  // No-op, nothing enforced.
+  // Resources carry no I/O limits, the volume options are the source of
+  // truth, so only the cgroup is brought back in line with them.
+  const std::function<Future<Nothing>()> throttleContainer =
+    [=]() { return throttle(containerId, None()); };
 
-  return Nothing();
+  return dispatch(isolatorProcess->self(), throttleContainer);
 }
 
 
 Future<ResourceStatistics> DockerVolumeDriverIsolator::usage(
     const ContainerID& containerId)
 {
-  // No-op, no usage gathered.
+  const std::function<ResourceStatistics()> containerUsage = [=]() {
+    ResourceStatistics statistics;
+
+#if MESOS_VERSION_INT >= 110 && MESOS_VERSION_INT < 200
+    foreach (const process::Owned<ExternalMount>& mount,
+             infos.get(containerId)) {
+      Option<VolumeStats> stats = volumeStats.get(mount->mountpoint());
+      if (stats.isNone()) {
+        continue;
+      }
 
-  return ResourceStatistics();
+      DiskStatistics* disk = statistics.add_disk_statistics();
+      disk->mutable_source()->set_type(Resource::DiskInfo::Source::MOUNT);
+      disk->mutable_source()->mutable_mount()->set_root(mount->mountpoint());
+      disk->set_limit_bytes(stats.get().capacityBytes);
+      disk->set_used_bytes(stats.get().usedBytes);
+
+#if MESOS_VERSION_INT >= 130
+      if (stats.get().disk.isSome()) {
+        const DiskStats& io = stats.get().disk.get();
+        CgroupInfo::Blkio::Throttling::Statistics* throttling =
+          statistics.mutable_blkio_statistics()->add_throttling();
+        throttling->mutable_device()->set_major_number(io.deviceMajor);
+        throttling->mutable_device()->set_minor_number(io.deviceMinor);
+
+        CgroupInfo::Blkio::Value* value = throttling->add_io_serviced();
+        value->set_op(CgroupInfo::Blkio::READ);
+        value->set_value(io.reads);
+        value = throttling->add_io_serviced();
+        value->set_op(CgroupInfo::Blkio::WRITE);
+        value->set_value(io.writes);
+        value = throttling->add_io_service_bytes();
+        value->set_op(CgroupInfo::Blkio::READ);
+        value->set_value(io.readBytes);
+        value = throttling->add_io_service_bytes();
+        value->set_op(CgroupInfo::Blkio::WRITE);
+        value->set_value(io.writeBytes);
+      }
+#endif
+    }
+#endif
+
+    return statistics;
+  };
+
+  return dispatch(isolatorProcess->self(), containerUsage);
 }
 
 Future<Nothing> DockerVolumeDriverIsolator::isolate(
     const ContainerID& containerId,
     pid_t pid)
 {
-  // No-op, isolation happens when mounting/unmounting in prepare/cleanup
+  // Volumes are mounted on the agent by prepare(), only their bind
+  // mounts and I/O throttling need the task's pid.
+  const std::function<Future<Nothing>()> isolateContainer = [=]() {
+    return bindVolumes(containerId, pid)
+      .then(defer(isolatorProcess->self(), [=]() {
+        return throttle(containerId, pid);
+      }));
+  };
+
+  return dispatch(isolatorProcess->self(), isolateContainer);
+}
+
+Future<Nothing> DockerVolumeDriverIsolator::bindVolumes(
+    const ContainerID& containerId,
+    pid_t pid)
+{
+  std::vector<BindMount> mounts;
+  foreach (const process::Owned<ExternalMount>& mount,
+           infos.get(containerId)) {
+    if (mount->container_path().empty()) {
+      continue; // empty container path means skip containerization
+    }
+
+    LOG(INFO) << "Bind mounting " << mount->mountpoint() << " at "
+              << mount->container_path()
+              << (mount->read_only() ? " read-only" : "")
+              << " for container " << containerId;
+    mounts.push_back(BindMount{
+        mount->mountpoint(), mount->container_path(), mount->read_only()});
+  }
+
+  return bindMounts(pid, mounts);
+}
+
+Future<Nothing> DockerVolumeDriverIsolator::throttle(
+    const ContainerID& containerId,
+    const Option<pid_t>& pid)
+{
+  // Keyed by device, the kernel limits a cgroup's I/O per device.
+  hashmap<string, IoThrottle> throttles;
+  foreach (const process::Owned<ExternalMount>& mount,
+           infos.get(containerId)) {
+    if (!mount->has_throttle()) {
+      continue;
+    }
+
+    Try<string> device = throttledDevice(mount->mountpoint());
+    if (device.isError()) {
+      return Failure("Failed to throttle I/O on " + mount->volumedriver() +
+                     "/" + mount->volumename() + ": " + device.error());
+    }
+    throttles[device.get()] = mount->throttle();
+  }
+
+  if (throttles.empty()) {
+    return Nothing();
+  }
+
+  // prepare() only accepts throttles with a hierarchy, but those of
+  // recovered containers may predate the agent losing it.
+  if (blkioHierarchy.isNone()) {
+    LOG(WARNING) << "Not throttling I/O of container " << containerId
+                 << ", no blkio cgroup hierarchy is in use";
+    return Nothing();
+  }
+
+  const string& hierarchy = blkioHierarchy.get();
+  const string cgroup = throttleCgroup(stringify(containerId));
+
+  Try<bool> exists = cgroups::exists(hierarchy, cgroup);
+  if (exists.isError()) {
+    return Failure("Failed to check for blkio cgroup " + cgroup + ": " +
+                   exists.error());
+  }
+
+  if (!exists.get()) {
+    if (pid.isNone()) {
+      return Nothing();
+    }
+
+    Try<Nothing> create = cgroups::create(hierarchy, cgroup, true);
+    if (create.isError()) {
+      return Failure("Failed to create blkio cgroup " + cgroup + ": " +
+                     create.error());
+    }
+  }
+
+  // Limits first, so the task never runs unthrottled in the cgroup.
+  Try<Nothing> apply = applyThrottles(hierarchy, cgroup, throttles);
+  if (apply.isError()) {
+    return Failure("Failed to throttle container " + stringify(containerId) +
+                   ": " + apply.error());
+  }
+
+  if (pid.isSome()) {
+    Try<Nothing> assign = cgroups::assign(hierarchy, cgroup, pid.get());
+    if (assign.isError()) {
+      return Failure("Failed to move pid " + stringify(pid.get()) +
+                     " into blkio cgroup " + cgroup + ": " + assign.error());
+    }
+  }
+
+  LOG(INFO) << "Throttled I/O of container " << containerId << " on "
+            << throttles.size() << " device(s)";
+
   return Nothing();
 }
 
+void DockerVolumeDriverIsolator::unthrottle(const ContainerID& containerId)
+{
+  if (blkioHierarchy.isNone()) {
+    return;
+  }
+
+  const string cgroup = throttleCgroup(stringify(containerId));
+
+  Try<bool> exists = cgroups::exists(blkioHierarchy.get(), cgroup);
+  if (exists.isError() || !exists.get()) {
+    return;
+  }
+
+  // The containerizer only cleans up once the container's processes
+  // are gone, so the cgroup is empty.
+  Try<Nothing> remove = cgroups::remove(blkioHierarchy.get(), cgroup);
+  if (remove.isError()) {
+    LOG(WARNING) << "Failed to remove blkio cgroup " << cgroup << ": "
+                 << remove.error();
+  }
+}
+
 Future<Nothing> DockerVolumeDriverIsolator::cleanup(
     const ContainerID& containerId)
+{
+  const std::function<Future<Nothing>()> detachMounts =
+    [=]() { return detach(containerId); };
+
+  return dispatch(isolatorProcess->self(), detachMounts);
+}
+
+Future<Nothing> DockerVolumeDriverIsolator::detach(
+    const ContainerID& containerId)
 {
   //    1. Get driver name and volume list from infos.
   //    2. Iterate list and perform unmounts.
 
+  unthrottle(containerId);
+
   if (!infos.contains(containerId)) {
     return Nothing();
   }
 
-  list<process::Owned<ExternalMount>> mountsList =
-      infos.get(containerId);
-  // mountList now contains all the mounts used by this container.
-
+  // Remove all this container's mounts from infos right away.
   // Note: it is possible that some of these mounts are
-  // also used by other tasks.
-  foreach(const process::Owned<ExternalMount> &mountFromThisContainer,
-          mountsList) {
-    size_t mountCount = 0;
-
-    foreachvalue (const process::Owned<ExternalMount> &mount, infos) {
-      // elem.second is ExternalMount.
-
-      if (getExternalMountId(*mountFromThisContainer) ==
-              getExternalMountId(*(mount.get()))) {
-        if( ++mountCount > 1) {
-          break; // As soon as we find two users we can quit.
+  // also used by other tasks, only the released ones are unmounted.
+  // Their unmounts are queued rather than waited for, the container is
+  // cleaned up as soon as the queue is durable in the journal.
+  std::vector<process::Owned<ExternalMount>> lingered;
+  foreach (const process::Owned<ExternalMount> &released,
+           untrackContainer(containerId)) {
+    // A prepare() waiting on this mount will take it over.
+    if (pendingMounts.contains(getExternalMountId(*released))) {
+      continue;
+    }
+
+    // This container was the only, or last, user of this mount.
+    lingered.push_back(linger(*released, unmountGracePeriod));
+  }
+
+  return journalRemove(containerId, lingered);
+}
+
+Future<http::Response> DockerVolumeDriverIsolator::preattach(
+    const http::Request& request)
+{
+  if (request.method != "POST") {
+    return http::BadRequest("Expecting POST\n");
+  }
+
+  Try<hashmap<string, string>> decode = http::query::decode(request.body);
+  if (decode.isError()) {
+    return http::BadRequest("Failed to decode the form: " + decode.error());
+  }
+
+  hashmap<string, string> form = decode.get();
+
+  const string volumeName = form.get("volumename").getOrElse("");
+  const string volumeDriver =
+    form.get("volumedriver").getOrElse(VOL_DRIVER_DEFAULT);
+  string options = form.get("options").getOrElse("");
+  const string backendName = form.get("backend").getOrElse(defaultBackend);
+
+  if (volumeName.empty()) {
+    return http::BadRequest("Missing volumename\n");
+  }
+  if (containsProhibitedChars(volumeName) ||
+      containsProhibitedChars(volumeDriver) ||
+      containsProhibitedChars(options)) {
+    return http::BadRequest("Prohibited character in the request\n");
+  }
+  if (!backends.contains(backendName)) {
+    return http::BadRequest("Unknown volume backend " + backendName + "\n");
+  }
+
+  // As in prepare(), throttle options never reach the driver. They
+  // limit a task's I/O, which a pre-attach has none of.
+  Try<Option<IoThrottle>> throttle = extractThrottle(&options);
+  if (throttle.isError()) {
+    return http::BadRequest(throttle.error() + "\n");
+  }
+
+  Try<Duration> ttl =
+    Duration::parse(form.get("ttl").getOrElse(DEFAULT_PREATTACH_TTL));
+  if (ttl.isError() || ttl.get() <= Duration::zero()) {
+    return http::BadRequest("ttl must be a duration such as 5mins\n");
+  }
+
+  // The dvdcli binary is not configurable here, the endpoint is reachable
+  // by anyone who can reach the agent.
+  process::Owned<ExternalMount> requestedMount(
+    Builder().setContainerId(DVDI_DETACH_CONTAINER_ID)
+             .setVolumeDriver(volumeDriver)
+             .setVolumeName(volumeName)
+             .setOptions(options)
+             .setDvdcliPath(DEFAULT_DVDCLI_BIN)
+             .setExplicitCreate(false)
+             .setBackend(backendName)
+             .build());
+
+  const ExternalMountID id = getExternalMountId(*requestedMount);
+
+  // Mounted volumes are used as they are. A queued one is kept for at
+  // least the TTL.
+  Future<string> mountpoint;
+  bool waiting = false;
+  if (infos.inUse(id)) {
+    mountpoint = infos.mountpoint(id).get();
+  } else if (lingering.contains(id)) {
+    mountpoint = lingering[id].mount->mountpoint();
+  } else if (pendingMounts.contains(id)) {
+    pendingMounts[id].waiters++;
+    ++metrics->driver(volumeDriver).coalesced_mounts;
+    mountpoint = pendingMounts[id].mountpoint;
+    waiting = true;
+  } else {
+    if (pendingUnmounts.contains(id)) {
+      mountpoint = pendingUnmounts[id]
+        .then(defer(isolatorProcess->self(), [=](bool) {
+          return mount(*requestedMount, "preattach");
+        }));
+    } else {
+      mountpoint = mount(*requestedMount, "preattach");
+    }
+    pendingMounts[id] = PendingMount{mountpoint, 1};
+    waiting = true;
+  }
+
+  const Duration pin = ttl.get();
+
+  return await(mountpoint)
+    .then(defer(isolatorProcess->self(), [=](
+        const Future<string>& result) -> Future<http::Response> {
+      if (waiting && --pendingMounts[id].waiters == 0) {
+        pendingMounts.erase(id);
+      }
+
+      if (!result.isReady()) {
+        return http::InternalServerError(
+            "Failed to mount " + volumeDriver + "/" + volumeName + ": " +
+            (result.isFailed() ? result.failure() : "discarded") + "\n");
+      }
+
+      requestedMount->set_mountpoint(result.get());
+      requestedMount->set_attached_at(Clock::now().secs());
+
+      JSON::Object response;
+      response.values["volumedriver"] = JSON::String(volumeDriver);
+      response.values["volumename"] = JSON::String(volumeName);
+      response.values["mountpoint"] = JSON::String(result.get());
+
+      // A container that joined the mount while it was pending owns it,
+      // it is queued for detach once that container is gone.
+      if (infos.inUse(id)) {
+        response.values["in_use"] = JSON::True();
+        return http::OK(response);
+      }
+
+      // An already queued volume keeps the backend it was mounted with.
+      ExternalMount pinned = *requestedMount;
+      Duration remaining = Duration::zero();
+      if (lingering.contains(id)) {
+        pinned = *lingering[id].mount;
+        Try<Duration> left =
+          Duration::create(pinned.linger_until() - Clock::now().secs());
+        if (left.isSome()) {
+          remaining = left.get();
         }
       }
+
+      const process::Owned<ExternalMount> queued =
+        linger(pinned, std::max(remaining, pin));
+      queued->set_pinned(true);
+
+      response.values["in_use"] = JSON::False();
+      response.values["expires"] = JSON::Number(queued->linger_until());
+
+      return journalQueue({queued})
+        .then([response]() -> http::Response {
+          return http::OK(response);
+        })
+        .repair([](
+            const Future<http::Response>& queued) -> Future<http::Response> {
+          return http::InternalServerError(queued.failure() + "\n");
+        });
+    }));
+}
+
+void DockerVolumeDriverIsolator::sampleUsage()
+{
+  // The last sample is still stuck on some volume, skip this one.
+  if (!sampling) {
+    hashset<string> mountpoints;
+    foreachvalue (const MountTable::MountRecord& record, infos.volumes()) {
+      mountpoints.insert(record.mount->mountpoint());
     }
 
-    if (1 == mountCount) {
-      // This container was the only, or last, user of this mount.
+    sampling = true;
+    dispatch(statsSampler->self(), &VolumeStatsSampler::sample, mountpoints)
+      .onAny(defer(isolatorProcess->self(), [this](
+          const Future<hashmap<string, VolumeStats>>& sampled) {
+        sampling = false;
+        if (sampled.isReady()) {
+          volumeStats = sampled.get();
+        }
+      }));
+  }
 
-      if (!unmount(*mountFromThisContainer, "cleanup()")) {
-        return Failure("cleanup() failed during unmount attempt");
+  process::after(usageSampleInterval)
+    .onReady(defer(isolatorProcess->self(), [this](const Nothing&) {
+      sampleUsage();
+    }));
+}
+
+void DockerVolumeDriverIsolator::inventoryUpdated()
+{
+  inventoryVersion++;
+
+  hashmap<uint64_t, process::Owned<process::Promise<Nothing>>> waiters;
+  std::swap(waiters, inventoryWaiters);
+
+  foreachvalue (const process::Owned<process::Promise<Nothing>>& waiter,
+                waiters) {
+    waiter->set(Nothing());
+  }
+}
+
+void DockerVolumeDriverIsolator::inventoryWaitExpired(uint64_t waiter)
+{
+  // Already answered by a change, or the client went away.
+  if (!inventoryWaiters.contains(waiter)) {
+    return;
+  }
+
+  process::Owned<process::Promise<Nothing>> expired =
+    inventoryWaiters.at(waiter);
+  inventoryWaiters.erase(waiter);
+  expired->set(Nothing());
+}
+
+static JSON::Object volumeObject(const ExternalMount& mount)
+{
+  JSON::Object volume;
+  volume.values["volumedriver"] = JSON::String(mount.volumedriver());
+  volume.values["volumename"] = JSON::String(mount.volumename());
+  volume.values["mountpoint"] = JSON::String(mount.mountpoint());
+  volume.values["backend"] = JSON::String(
+      mount.backend().empty() ? DVDI_BACKEND_DVDCLI : mount.backend());
+  if (mount.has_attached_at()) {
+    volume.values["attached_at"] = JSON::Number(mount.attached_at());
+  }
+  return volume;
+}
+
+static JSON::Object usageObject(const VolumeStats& stats)
+{
+  JSON::Object usage;
+  usage.values["capacity_bytes"] = JSON::Number(stats.capacityBytes);
+  usage.values["used_bytes"] = JSON::Number(stats.usedBytes);
+  if (stats.disk.isSome()) {
+    usage.values["reads"] = JSON::Number(stats.disk.get().reads);
+    usage.values["read_bytes"] = JSON::Number(stats.disk.get().readBytes);
+    usage.values["writes"] = JSON::Number(stats.disk.get().writes);
+    usage.values["write_bytes"] = JSON::Number(stats.disk.get().writeBytes);
+  }
+  usage.values["sampled_at"] = JSON::Number(stats.sampledAt);
+  return usage;
+}
+
+JSON::Object DockerVolumeDriverIsolator::inventory() const
+{
+  JSON::Array array;
+
+  foreachvalue (const MountTable::MountRecord& record, infos.volumes()) {
+    JSON::Object volume = volumeObject(*record.mount);
+
+    const string key = mountKey(*record.mount);
+
+    JSON::Array containers;
+    JSON::Array bindMounts;
+    foreach (const ContainerID& containerId, record.containers) {
+      containers.values.push_back(JSON::String(containerId.value()));
+
+      foreach (const process::Owned<ExternalMount>& mount,
+               infos.get(containerId)) {
+        if (mountKey(*mount) != key || mount->container_path().empty()) {
+          continue;
+        }
+        JSON::Object bindMount;
+        bindMount.values["container_id"] = JSON::String(containerId.value());
+        bindMount.values["container_path"] =
+          JSON::String(mount->container_path());
+        bindMount.values["mode"] =
+          JSON::String(mount->read_only() ? "ro" : "rw");
+        bindMounts.values.push_back(bindMount);
       }
     }
+
+    volume.values["refcount"] = JSON::Number(record.refcount);
+    volume.values["containers"] = containers;
+    volume.values["bind_mounts"] = bindMounts;
+    volume.values["queued_for_detach"] = JSON::False();
+    if (volumeStats.contains(record.mount->mountpoint())) {
+      volume.values["usage"] =
+        usageObject(volumeStats.at(record.mount->mountpoint()));
+    }
+    array.values.push_back(volume);
   }
 
-  // Remove all this container's mounts from infos.
-  infos.remove(containerId);
+  foreachpair (const ExternalMountID& id,
+               const LingeringMount& lingeringMount,
+               lingering) {
+    // Already listed, see _expire().
+    if (infos.inUse(id)) {
+      continue;
+    }
 
-  // Create ExternalMountList protobuf message to checkpoint
-  ExternalMountList inUseMountsProtobuf;
-  foreachvalue( const process::Owned<ExternalMount> &mount, infos) {
-    ExternalMount* mountptr = inUseMountsProtobuf.add_mount();
-    mountptr->CopyFrom(*(mount.get()));
+    JSON::Object volume = volumeObject(*lingeringMount.mount);
+    volume.values["refcount"] = JSON::Number(0);
+    volume.values["containers"] = JSON::Array();
+    volume.values["queued_for_detach"] = JSON::True();
+    volume.values["detach_after"] =
+      JSON::Number(lingeringMount.mount->linger_until());
+    array.values.push_back(volume);
   }
-  mesos::internal::slave::state::checkpoint(mountPbFilename,
-    inUseMountsProtobuf);
 
-  return Nothing();
+  JSON::Object object;
+  object.values["version"] = JSON::Number(inventoryVersion);
+  object.values["volumes"] = array;
+  return object;
+}
+
+Future<http::Response> DockerVolumeDriverIsolator::volumes(
+    const http::Request& request)
+{
+#if MESOS_VERSION_INT < 200 || MESOS_VERSION_INT >= 280
+  const hashmap<string, string>& query = request.url.query;
+#else
+  const hashmap<string, string>& query = request.query;
+#endif
+
+  if (!query.contains("version")) {
+    return http::OK(inventory());
+  }
+
+  Try<uint64_t> version = numify<uint64_t>(query.at("version"));
+  if (version.isError()) {
+    return http::BadRequest("Invalid version: " + version.error() + "\n");
+  }
+
+  Try<Duration> timeout = Duration::parse(
+      query.get("timeout").getOrElse(DEFAULT_VOLUMES_WATCH_TIMEOUT));
+  if (timeout.isError() || timeout.get() < Duration::zero()) {
+    return http::BadRequest("timeout must be a duration such as 30secs\n");
+  }
+
+  // The client is behind already, or asked not to wait.
+  if (version.get() != inventoryVersion || timeout.get() == Duration::zero()) {
+    return http::OK(inventory());
+  }
+
+  // Each client waits on a promise of its own, so nothing of a client
+  // that timed out or disconnected is kept until the next change.
+  const uint64_t waiter = nextInventoryWaiter++;
+  process::Owned<process::Promise<Nothing>> changed(
+      new process::Promise<Nothing>());
+  inventoryWaiters[waiter] = changed;
+
+  process::after(std::min(timeout.get(),
+                          Duration::parse(MAX_VOLUMES_WATCH_TIMEOUT).get()))
+    .onReady(defer(isolatorProcess->self(), [this, waiter](const Nothing&) {
+      inventoryWaitExpired(waiter);
+    }));
+
+  return changed->future()
+    .onDiscard(defer(isolatorProcess->self(), [this, waiter]() {
+      inventoryWaiters.erase(waiter);
+    }))
+    .then(defer(isolatorProcess->self(), [this]() -> http::Response {
+      return http::OK(inventory());
+    }));
 }
 
 static Isolator* createDockerVolumeDriverIsolator(const Parameters& parameters)
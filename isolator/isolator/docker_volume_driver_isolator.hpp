@@ -19,23 +19,43 @@
 
 #ifndef SRC_DOCKER_VOLUME_DRIVER_ISOLATOR_HPP_
 #define SRC_DOCKER_VOLUME_DRIVER_ISOLATOR_HPP_
+#include <functional>
 #include <iostream>
-#include <boost/functional/hash.hpp>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
 #include <boost/algorithm/string.hpp>
 #include <mesos/mesos.hpp>
 
 #include <process/future.hpp>
+#include <process/http.hpp>
+#include <process/id.hpp>
 #include <process/owned.hpp>
 #include <process/process.hpp>
 
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/json.hpp>
 #include <stout/multihashmap.hpp>
+#include <stout/nothing.hpp>
 #include <stout/protobuf.hpp>
 #include <stout/try.hpp>
 
 #include <slave/flags.hpp>
 #include <mesos/slave/isolator.hpp>
 
+#include "admission_queue.hpp"
+#include "bind_mount.hpp"
 #include "interface.hpp"
+#include "io_throttle.hpp"
+#include "metrics.hpp"
+#include "mount_info.hpp"
+#include "mount_journal.hpp"
+#include "mount_table.hpp"
+#include "volume_backend.hpp"
+#include "volume_plugin.hpp"
+#include "volume_stats.hpp"
 using namespace emccode::isolator::mount;
 
 
@@ -44,26 +64,121 @@ namespace slave {
 
 static constexpr char DVDI_MOUNTLIST_PATH[]       = "/var/run/mesos/isolators/mesos-module-dvdi/";
 static constexpr char REXRAY_MOUNT_PREFIX[]       = "/var/lib/rexray/volumes/";
-static constexpr char DVDCLI_MOUNT_CMD[]          = "mount";
-static constexpr char DVDCLI_UNMOUNT_CMD[]        = "unmount";
-
-static constexpr char VOL_NAME_CMD_OPTION[]       = "--volumename=";
-static constexpr char VOL_DRIVER_CMD_OPTION[]     = "--volumedriver=";
-static constexpr char VOL_OPTS_CMD_OPTION[]       = "--volumeopts=";
 static constexpr char VOL_DRIVER_DEFAULT[]        = "rexray";
 
+static constexpr char VOL_ENV_VAR_PREFIX[]        = "DVDI_VOLUME_";
 static constexpr char VOL_NAME_ENV_VAR_NAME[]     = "DVDI_VOLUME_NAME";
 static constexpr char VOL_DRIVER_ENV_VAR_NAME[]   = "DVDI_VOLUME_DRIVER";
 static constexpr char VOL_OPTS_ENV_VAR_NAME[]     = "DVDI_VOLUME_OPTS";
 static constexpr char VOL_CPATH_ENV_VAR_NAME[]    = "DVDI_VOLUME_CONTAINERPATH";
 static constexpr char VOL_DVDCLI_ENV_VAR_NAME[]   = "DVDI_VOLUME_DVDCLI";
 static constexpr char VOL_EXPLICIT_ENV_VAR_NAME[]  = "DVDI_VOLUME_EXPLICITCREATE";
+static constexpr char VOL_BACKEND_ENV_VAR_NAME[]  = "DVDI_VOLUME_BACKEND";
+static constexpr char VOL_MODE_ENV_VAR_NAME[]     = "DVDI_VOLUME_MODE";
+static constexpr char VOL_PRIORITY_ENV_VAR_NAME[] = "DVDI_VOLUME_PRIORITY";
+static constexpr char VOLS_ENV_VAR_NAME[]         = "DVDI_VOLUMES";
 
+// Single file mount list written by earlier releases, only read by recover().
 static constexpr char DVDI_MOUNTLIST_FILENAME[]   = "dvdimounts.pb";
 static constexpr char DVDI_WORKDIR_PARAM_NAME[]   = "work_dir";
+static constexpr char DVDI_STATEDIR_PARAM_NAME[]  = "state_dir";
+static constexpr char DVDI_RECOVERSTATE_PARAM_NAME[] = "recover_agent_state";
+static constexpr char DVDI_IOTHROTTLING_PARAM_NAME[] = "io_throttling";
+static constexpr char DVDI_BACKEND_PARAM_NAME[]   = "volume_backend";
+static constexpr char DVDI_PLUGINDIR_PARAM_NAME[] = "plugin_socket_dir";
+static constexpr char DVDI_FAKEDIR_PARAM_NAME[]   = "fake_backend_dir";
+static constexpr char DVDI_FAKELATENCY_PARAM_NAME[] = "fake_backend_latency";
+static constexpr char DVDI_FAKEFAILURES_PARAM_NAME[] =
+                                                "fake_backend_failure_rate";
+static constexpr char DVDI_MAXCONCURRENT_PARAM_NAME[] =
+                                                    "max_concurrent_operations";
+static constexpr size_t DEFAULT_MAX_CONCURRENT_OPERATIONS = 16;
+static constexpr char DVDI_DRIVERLIMITS_PARAM_NAME[] =
+                                                "driver_concurrency_limits";
+static constexpr char DVDI_COMPACTION_PARAM_NAME[] =
+                                                "journal_compaction_interval";
+static constexpr size_t DEFAULT_JOURNAL_COMPACTION_INTERVAL = 1000;
+static constexpr char DVDI_COMMITWINDOW_PARAM_NAME[] = "journal_commit_window";
+static constexpr char DEFAULT_JOURNAL_COMMIT_WINDOW[] = "5ms";
+static constexpr char DVDI_RECOVERCONCURRENCY_PARAM_NAME[] =
+                                                        "recover_concurrency";
+static constexpr size_t DEFAULT_RECOVER_CONCURRENCY = 8;
+static constexpr char DVDI_RECOVERTIMEOUT_PARAM_NAME[] =
+                                                    "recover_unmount_timeout";
+static constexpr char DEFAULT_RECOVER_UNMOUNT_TIMEOUT[] = "2mins";
+static constexpr char DVDI_GRACEPERIOD_PARAM_NAME[] = "unmount_grace_period";
+static constexpr char DEFAULT_UNMOUNT_GRACE_PERIOD[] = "0secs";
+static constexpr char DVDI_USAGEINTERVAL_PARAM_NAME[] =
+                                                      "usage_sample_interval";
+static constexpr char DEFAULT_USAGE_SAMPLE_INTERVAL[] = "15secs";
+// Owner of the queued detaches in the journal, see
+// DockerVolumeDriverIsolator::lingering. Mesos container IDs are UUIDs,
+// so this never names a real container.
+static constexpr char DVDI_DETACH_CONTAINER_ID[]  = "dvdi-detach-queue";
+
+// The isolator actor, and so its endpoints, e.g. /dvdi/preattach.
+static constexpr char DVDI_PROCESS_ID[]           = "dvdi";
+static constexpr char DVDI_PREATTACH_ENDPOINT[]   = "preattach";
+static constexpr char DEFAULT_PREATTACH_TTL[]     = "5mins";
+#if MESOS_VERSION_INT >= 110 && MESOS_VERSION_INT < 200
+// The agent's realm for endpoints that change its state.
+static constexpr char DVDI_PREATTACH_REALM[]      = "mesos-agent-readwrite";
+#elif MESOS_VERSION_INT >= 100 && MESOS_VERSION_INT < 200
+static constexpr char DVDI_PREATTACH_REALM[]      = "mesos-agent";
+#endif
+static constexpr char DVDI_VOLUMES_ENDPOINT[]     = "volumes";
+static constexpr char DEFAULT_VOLUMES_WATCH_TIMEOUT[] = "30secs";
+static constexpr char MAX_VOLUMES_WATCH_TIMEOUT[] = "10mins";
 static constexpr char DEFAULT_WORKING_DIR[]       = "/tmp/mesos";
 static constexpr char DEFAULT_DVDCLI_BIN[]        = "/usr/bin/dvdcli";
 
+// Actor on which all mount bookkeeping is performed.
+// dvdcli runs as asynchronous child processes and their completions
+// are deferred back onto this actor, so a slow attach never blocks
+// the agent and infos is never modified concurrently.
+class DockerVolumeDriverIsolatorProcess
+  : public process::Process<DockerVolumeDriverIsolatorProcess>
+{
+public:
+  using Handler = std::function<
+    process::Future<process::http::Response>(const process::http::Request&)>;
+
+  DockerVolumeDriverIsolatorProcess()
+    : ProcessBase(DVDI_PROCESS_ID) {}
+
+  // Serves the handler at /dvdi/<name>. Handlers run on this actor, so
+  // they may use the isolator's state directly. Must be called before
+  // the actor is spawned.
+  void serve(
+      const std::string& name,
+      const std::string& help,
+      const Handler&     handler)
+  {
+    route("/" + name, help, handler);
+  }
+
+#if MESOS_VERSION_INT >= 100 && MESOS_VERSION_INT < 200
+  // Same, behind the agent's HTTP authentication for `realm`: requests
+  // need credentials whenever the agent has an authenticator for it.
+  void serve(
+      const std::string& name,
+      const std::string& realm,
+      const std::string& help,
+      const Handler&     handler)
+  {
+    route("/" + name, realm, help, [handler](
+        const process::http::Request& request,
+#if MESOS_VERSION_INT >= 120
+        const Option<process::http::authentication::Principal>&) {
+#else
+        const Option<std::string>&) {
+#endif
+      return handler(request);
+    });
+  }
+#endif
+};
+
 #if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
 class DockerVolumeDriverIsolator: public mesos::slave::IsolatorProcess
 #else
@@ -102,8 +217,9 @@ public:
   // 3. Check for other pre-existing users of the mount.
   // 4. Only if we are first user, make dvdcli mount call <volumename>
   //    Mount location is fixed, based on volume name (/var/lib/rexray/volumes/
-  //    this call is synchronous, and returns 0 if success
-  //    actual call is defined below in DVDCLI_MOUNT_CMD
+  //    this call is asynchronous, the returned future completes
+  //    once dvdcli has exited
+  //    actual call is defined in DVDCLI_MOUNT_CMD, see volume_backend.hpp
   // 5. Add entry to hashmap that contains root mountpath indexed by ContainerId
 #if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
   virtual process::Future<Option<CommandInfo>> prepare(
@@ -124,7 +240,10 @@ public:
     const ContainerConfig& containerConfig);
 #endif
 
-  // Nothing will be done at task start
+  // Bind mounts the volumes at their container paths inside the task's
+  // mount namespace, see bind_mount.hpp. Then moves the task into a
+  // blkio cgroup limiting its I/O on the volumes it has throttle
+  // options for, see io_throttle.hpp.
   virtual process::Future<Nothing> isolate(
     const ContainerID& containerId,
       pid_t pid);
@@ -138,76 +257,321 @@ public:
     const ContainerID& containerId);
 #endif
 
-  // no-op, nothing enforced
+  // Sets the throttles of the container's volumes again, e.g. after
+  // the blkio cgroup was changed from outside.
   virtual process::Future<Nothing> update(
     const ContainerID& containerId,
     const Resources& resources);
 
-  // no-op, no usage stats gathered
+  // Reports the last sampled capacity, used bytes and I/O of the
+  // container's volumes, see volume_stats.hpp.
   virtual process::Future<ResourceStatistics> usage(
     const ContainerID& containerId);
 
   // will (possibly) unmount here
   // 1. Get mount root path by looking up based on ContainerId
-  // 2. Start counting tasks using this same mount. Quit counted after count == 2
-  // 3. If count was exactly 1, Unmount the volume
-  //     dvdcli unmount defined in DVDCLI_UNMOUNT_CMD below
+  // 2. Drop this task's reference on each mount in the mount index
+  // 3. If that was the last reference, Unmount the volume
+  //     dvdcli unmount defined in DVDCLI_UNMOUNT_CMD, see volume_backend.hpp
+  //     in the background, once any unmount grace period has run out
   // 4. Remove the listing for this task's mount from hashmap
   virtual process::Future<Nothing> cleanup(
     const ContainerID& containerId);
 
+  // Returns true if string contains at least one prohibited character
+  // as defined in the list below.
+  // This is intended as a tool to detect injection attack attempts.
+  static bool containsProhibitedChars(const std::string& s);
+
+  // A volume requested by a task.
+  struct VolumeSpec
+  {
+    std::string name;
+    std::string driver;
+    std::string options;
+    std::string containerPath;
+    std::string dvdcliPath;
+    std::string explicitCreate;
+    std::string backend;
+    std::string mode;
+    std::string priority;
+  };
+
+  // Parses the task's DVDI_VOLUME_<FIELD><n> variables, for any number
+  // n, and the volumes listed in DVDI_VOLUMES, in one pass over the
+  // environment. Returns the volumes with a name, the numbered ones
+  // first, in order of their number.
+  static Try<std::vector<VolumeSpec>> parseVolumeSpecs(
+    const Environment& environment);
+
 private:
 
   DockerVolumeDriverIsolator(const Parameters& parameters);
 
   const Parameters parameters;
 
-  using ExternalMountID = size_t;
+  // The full normalized key rather than a hash of it, so two volumes
+  // whose hashes collide are never treated as one.
+  using ExternalMountID = std::string;
 
-  ExternalMountID getExternalMountId(ExternalMount& em) const {
-    size_t seed = 0;
-    std::string s1(boost::to_lower_copy(em.volumedriver()));
-    std::string s2(boost::to_lower_copy(em.volumename()));
-    boost::hash_combine(seed, s1);
-    boost::hash_combine(seed, s2);
-    return seed;
+  // See mountKey().
+  ExternalMountID getExternalMountId(const ExternalMount& em) const {
+    return mountKey(em);
   }
 
-  // Attempts to unmount specified external mount, returns true on success
-  bool unmount(
+  // Attempts to unmount specified external mount,
+  // returned future is true on success. A failure of the backend is
+  // taken for a volume unmounted by hand unless assumeUnmounted is
+  // false, in which case the future fails.
+  process::Future<bool> unmount(
     const ExternalMount& em,
-    const std::string&   callerLabelForLogging) const;
+    const std::string&   callerLabelForLogging,
+    bool                 assumeUnmounted = true) const;
 
   // Attempts to mount specified external mount,
-  // returns non-empty string (mountpoint) on success
-  std::string mount(
+  // returned future holds the non-empty mountpoint on success
+  process::Future<std::string> mount(
     const ExternalMount& em,
     const std::string&   callerLabelForLogging) const;
 
-  // Returns true if string contains at least one prohibited character
-  // as defined in the list below.
-  // This is intended as a tool to detect injection attack attempts.
-  bool containsProhibitedChars(const std::string& s) const;
-
-  using envvararray = std::array<std::string, 10>;
-
-  // Helper function for parsing environement variables into arrays of string
-  // Returns true if environment variable name and value are valid
-  bool parseEnvVar(
-    const Environment_Variable&  envvar,
-    const char*                  expectedName,
-    envvararray                  (&insertTarget),
-    bool                         limitCharset) const;
+  // Same as unmount(), but shares an unmount of the same volume that is
+  // already in flight instead of invoking dvdcli again.
+  // Must be called on the isolator actor.
+  process::Future<bool> unmountOnce(
+    const ExternalMount& em,
+    const std::string&   callerLabelForLogging);
+
+  // Second half of prepare(), run on the isolator actor.
+  // Mounts every requested volume not already in use by another
+  // container and records the container's mounts in infos.
+  // isolate() bind mounts them into the container.
+  process::Future<Nothing> attach(
+    const ContainerID&                               containerId,
+    const std::vector<process::Owned<ExternalMount>> requestedMounts);
+
+  // Continuation of attach() once all new mounts have succeeded.
+  // reclaimedMounts are the new mounts taken over from lingering.
+  process::Future<Nothing> _attach(
+    const ContainerID&                               containerId,
+    const std::vector<process::Owned<ExternalMount>> prevConnectedMounts,
+    const std::vector<process::Owned<ExternalMount>> newMounts,
+    const std::vector<process::Owned<ExternalMount>> reclaimedMounts);
+
+  // Body of cleanup(), run on the isolator actor.
+  process::Future<Nothing> detach(const ContainerID& containerId);
+
+  // First half of isolate(): bind mounts the container's volumes that
+  // have a container path into the mount namespace of `pid`.
+  process::Future<Nothing> bindVolumes(
+    const ContainerID&  containerId,
+    pid_t               pid);
+
+  // Body of update() and second half of isolate(): applies the throttles of the
+  // container's volumes to its blkio cgroup, moving `pid` into it.
+  // Without a pid the cgroup is only updated if it exists.
+  process::Future<Nothing> throttle(
+    const ContainerID&    containerId,
+    const Option<pid_t>&  pid);
+
+  // Removes the container's blkio cgroup, if it has one.
+  void unthrottle(const ContainerID& containerId);
+
+  // Serves DVDI_PREATTACH_ENDPOINT: mounts a volume ahead of the task
+  // that will use it and puts it on the detach queue for the requested
+  // TTL, for that task's prepare() to take over.
+  process::Future<process::http::Response> preattach(
+    const process::http::Request& request);
+
+  // Serves DVDI_VOLUMES_ENDPOINT: every volume mounted on the agent,
+  // whether used by containers or queued for detach. Given the version
+  // of the last response it got, a client is only answered once the
+  // list has changed, or after a timeout.
+  process::Future<process::http::Response> volumes(
+    const process::http::Request& request);
+
+  JSON::Object inventory() const;
+
+  // Bumped on every change to the volumes listed by inventory().
+  uint64_t inventoryVersion = 0;
+
+  // One promise per client waiting for the next change, dropped once
+  // it is answered: on a change, on its timeout or when it goes away.
+  hashmap<uint64_t, process::Owned<process::Promise<Nothing>>>
+    inventoryWaiters;
+  uint64_t nextInventoryWaiter = 0;
+
+  void inventoryUpdated();
+
+  void inventoryWaitExpired(uint64_t waiter);
 
   // helper function to "unroll" mounts when a list is submitted
   // and a munt fails. Goal is do all mounts or none.
+  // The unmounts are started in the background, the returned
+  // Failure is meant to be handed straight back to the containerizer.
+  // Mounts still wanted by another container are left alone.
   process::Failure revertMountlist(
     const char*                                      operation,
-    const std::vector<process::Owned<ExternalMount>> mounts) const;
+    const std::vector<process::Owned<ExternalMount>> mounts);
+
+  // The mounts of every container, see mount_table.hpp.
+  MountTable infos;
+
+  // The agent's mount table, see mount_info.hpp.
+  MountInfoIndex mountInfo;
+
+  // Body of recover(), run on the isolator actor so nothing else
+  // touches infos, lingering or the journal meanwhile.
+#if MESOS_VERSION_INT > 200 && MESOS_VERSION_INT < 240
+  process::Future<Nothing> _recover(
+    const std::list<mesos::slave::ExecutorRunState>& states,
+    const hashset<ContainerID>& orphans);
+#else
+  process::Future<Nothing> _recover(
+    const std::list<ContainerState>& states,
+    const hashset<ContainerID>& orphans);
+#endif
+
+  // Whether the volume's filesystem shows up in the agent's mount
+  // table. Backends that mount nothing always pass, and so does every
+  // volume if the mount table cannot be read.
+  bool confirmMounted(const ExternalMount& em);
+
+  // Records a mount of the container in infos.
+  void trackMount(
+    const ContainerID&                   containerId,
+    const process::Owned<ExternalMount>& mount);
+
+  // Removes all of the container's mounts from infos,
+  // returns the mounts this container was the last user of.
+  std::vector<process::Owned<ExternalMount>> untrackContainer(
+    const ContainerID& containerId);
 
-  using containermountmap =
-    multihashmap<ContainerID, process::Owned<ExternalMount>>;
-  containermountmap infos;
+  // A mount some prepare() calls are still waiting on, either because
+  // dvdcli has not returned yet or because the waiters have not yet
+  // recorded it in infos. Further prepare() calls for the same volume
+  // join it instead of invoking dvdcli again.
+  struct PendingMount
+  {
+    process::Future<std::string> mountpoint;
+    size_t waiters;
+  };
+
+  hashmap<ExternalMountID, PendingMount> pendingMounts;
+
+  // dvdcli unmounts in flight. A prepare() of the same volume is
+  // ordered after the unmount, a second unmount request shares it.
+  hashmap<ExternalMountID, process::Future<bool>> pendingUnmounts;
+
+  // The detach queue: volumes no container uses any more, still mounted.
+  // cleanup() only has to journal them here, the unmounts run in the
+  // background. Each volume first waits out its grace period, in case a
+  // container on this agent wants it again (see
+  // DVDI_GRACEPERIOD_PARAM_NAME), then a free detachLimiter slot.
+  // Until its unmount starts, a prepare() takes the volume over as it
+  // is, without invoking dvdcli; after that, it waits for the unmount
+  // in pendingUnmounts.
+  struct LingeringMount
+  {
+    // Journaled as owned by DVDI_DETACH_CONTAINER_ID.
+    process::Owned<ExternalMount> mount;
+    process::Future<Nothing> timer;
+    uint64_t generation;
+  };
+
+  hashmap<ExternalMountID, LingeringMount> lingering;
+  uint64_t lingerGeneration = 0;
+
+  // Keeps the volume mounted for `duration`, returns the copy of the
+  // mount to journal. Without `schedule`, the grace period only starts
+  // counting down once scheduleExpire() is called, as recover() does
+  // once it is done.
+  process::Owned<ExternalMount> linger(
+    const ExternalMount& mount,
+    const Duration&      duration,
+    bool                 schedule = true);
+
+  // Starts the timer of the queued detach, which runs out at the
+  // mount's linger_until.
+  void scheduleExpire(const ExternalMountID& id);
+
+  // Takes the volume off the detach queue, if it is on it.
+  // Returns whether it was.
+  bool unlinger(const ExternalMountID& id);
+
+  // Queues the unmount of the volume once its grace period is over,
+  // unless it was taken over or lingered again since.
+  void expire(const ExternalMountID& id, uint64_t generation);
+
+  // Unmounts the volume once expire() got it a detachLimiter slot,
+  // unless it was taken over while waiting.
+  void _expire(const ExternalMountID& id, uint64_t generation);
+
+  process::Owned<DockerVolumeDriverIsolatorProcess> isolatorProcess;
+
+  // Durable copy of infos, see mount_journal.hpp.
+  // Only recover() reads the journal directly, before anything is
+  // committed; all changes, compactions included, go through
+  // journalWriter.
+  process::Owned<MountJournal> journal;
+  process::Owned<MountJournalWriter> journalWriter;
+
+  // Commits the container's mounts to the journal, taking those it
+  // took over off the detach queue.
+  // The future is satisfied once they are on disk.
+  process::Future<Nothing> journalAdd(
+    const ContainerID&                                containerId,
+    const std::vector<process::Owned<ExternalMount>>& mounts,
+    const std::vector<process::Owned<ExternalMount>>& reclaimed =
+      std::vector<process::Owned<ExternalMount>>());
+
+  // Commits the removal of the container's mounts to the journal, along
+  // with the detaches it queued.
+  process::Future<Nothing> journalRemove(
+    const ContainerID&                                containerId,
+    const std::vector<process::Owned<ExternalMount>>& lingered =
+      std::vector<process::Owned<ExternalMount>>());
+
+  // Commits putting the volumes on the detach queue.
+  process::Future<Nothing> journalQueue(
+    const std::vector<process::Owned<ExternalMount>>& mounts);
+
+  // Commits taking the volumes off the detach queue.
+  process::Future<Nothing> journalRelease(
+    const std::vector<process::Owned<ExternalMount>>& mounts);
+
+  // Writes all of infos and lingering, plus the given mounts of
+  // containers that are gone, into a new journal snapshot. The
+  // snapshot is taken now and written by journalWriter, after the
+  // records committed before it.
+  // Only used by recover().
+  process::Future<Nothing> compactJournal(
+    const std::vector<process::Owned<ExternalMount>>& orphanMounts);
+
+  // Admits every mount and unmount, see DVDI_MAXCONCURRENT_PARAM_NAME
+  // and DVDI_DRIVERLIMITS_PARAM_NAME.
+  process::Owned<AdmissionQueue> admissions;
+
+  // Bounds the queued detaches being unmounted at once, see lingering.
+  // The others stay queued, and so can still be taken over.
+  std::shared_ptr<ConcurrencyLimiter> detachLimiter;
+
+  // Keyed by ExternalMount.backend, see volume_backend.hpp.
+  hashmap<std::string, std::shared_ptr<VolumeBackend>> backends;
+
+  std::shared_ptr<VolumeBackend> backend(const ExternalMount& em) const;
+
+  // Published through the Mesos metrics process, see metrics.hpp.
+  process::Owned<DvdiMetrics> metrics;
+
+  // Samples the volumes away from the isolator actor, see
+  // volume_stats.hpp. volumeStats holds the last sample, keyed by
+  // mountpoint.
+  process::Owned<VolumeStatsSampler> statsSampler;
+  hashmap<std::string, VolumeStats> volumeStats;
+  bool sampling = false;
+
+  // Samples the volumes in use, then again every usageSampleInterval.
+  void sampleUsage();
 
   // compiler had issues with the autodetecting size of following array,
   // thus a constant is defined
@@ -221,6 +585,25 @@ private:
 
   static std::string mountPbFilename;
   static std::string mesosWorkingDir;
+  static std::string stateDir;
+  static bool recoverAgentState;
+  static bool ioThrottling;
+  static std::string defaultBackend;
+  static std::string pluginSocketDir;
+  static std::string fakeBackendDir;
+  static Duration fakeBackendLatency;
+  static double fakeBackendFailureRate;
+  static size_t maxConcurrentOperations;
+  static hashmap<std::string, size_t> driverConcurrencyLimits;
+  static size_t journalCompactionInterval;
+  static Duration journalCommitWindow;
+  static size_t recoverConcurrency;
+  static Duration recoverUnmountTimeout;
+  static Duration unmountGracePeriod;
+  static Duration usageSampleInterval;
+
+  // Where the blkio cgroup hierarchy is mounted, none if it is not.
+  static Option<std::string> blkioHierarchy;
 };
 
 } /* namespace slave */
@@ -4,8 +4,21 @@
 #include <isolator/interface.pb.h>
 using namespace emccode::isolator::mount;
 
+#include <boost/algorithm/string.hpp>
+
 #include <stout/multihashmap.hpp>
 
+// Returns the normalized key identifying a volume regardless of which
+// container uses it. Volume driver and name are matched case insensitively,
+// '/' is a prohibited character in both so the key is unambiguous.
+inline std::string volumeKey(
+    const std::string& volumeDriver,
+    const std::string& volumeName)
+{
+  return boost::to_lower_copy(volumeDriver) + "/" +
+         boost::to_lower_copy(volumeName);
+}
+
 class Builder
 {
 private:
@@ -18,6 +31,9 @@ private:
   std::string containerPath;
   std::string dvdcliPath;
   bool        explicitCreate;
+  std::string backend;
+  bool        readOnly = false;
+  int         priority = 0;
 
 public:
   // create Builder with default values assigned
@@ -67,6 +83,24 @@ public:
     return *this;
   }
 
+  Builder& setBackend( const std::string _backend )
+  {
+    this->backend = _backend;
+    return *this;
+  }
+
+  Builder& setReadOnly( const bool _readOnly )
+  {
+    this->readOnly = _readOnly;
+    return *this;
+  }
+
+  Builder& setPriority( const int _priority )
+  {
+    this->priority = _priority;
+    return *this;
+  }
+
   ExternalMount* build()
   {
     ExternalMount* mount = new ExternalMount();
@@ -78,6 +112,10 @@ public:
     mount->set_container_path(containerPath);
     mount->set_dvdcli_path(dvdcliPath);
     mount->set_explicit_create(explicitCreate);
+    mount->set_backend(backend);
+    mount->set_read_only(readOnly);
+    mount->set_priority(priority);
+    mount->set_volume_key(volumeKey(volumeDriver, volumeName));
     return mount;
   }
 };
@@ -0,0 +1,214 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <utility>
+#include <vector>
+
+#include <stout/bytes.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "linux/cgroups.hpp"
+
+#include "io_throttle.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace slave {
+
+static Try<uint64_t> parseBytes(const string& value)
+{
+  Try<uint64_t> bytes = numify<uint64_t>(value);
+  if (bytes.isSome()) {
+    return bytes.get();
+  }
+
+  Try<Bytes> parsed = Bytes::parse(value);
+  if (parsed.isError()) {
+    return Error(parsed.error());
+  }
+  return parsed.get().bytes();
+}
+
+Try<Option<IoThrottle>> extractThrottle(string* options)
+{
+  IoThrottle throttle;
+  bool throttled = false;
+  vector<string> remaining;
+
+  foreach (const string& option, strings::tokenize(*options, ",")) {
+    const vector<string> pair = strings::split(option, "=", 2);
+    const string key = strings::trim(pair[0]);
+
+    if (key != THROTTLE_READ_BPS_OPTION &&
+        key != THROTTLE_WRITE_BPS_OPTION &&
+        key != THROTTLE_READ_IOPS_OPTION &&
+        key != THROTTLE_WRITE_IOPS_OPTION) {
+      remaining.push_back(option);
+      continue;
+    }
+
+    if (pair.size() != 2) {
+      return Error("Missing value of " + key);
+    }
+
+    const string value = strings::trim(pair[1]);
+    Try<uint64_t> limit = strings::endsWith(key, "_bps")
+      ? parseBytes(value)
+      : numify<uint64_t>(value);
+    if (limit.isError() || limit.get() == 0) {
+      return Error("Invalid " + key + " '" + value + "', must be positive");
+    }
+
+    if (key == THROTTLE_READ_BPS_OPTION) {
+      throttle.set_read_bps(limit.get());
+    } else if (key == THROTTLE_WRITE_BPS_OPTION) {
+      throttle.set_write_bps(limit.get());
+    } else if (key == THROTTLE_READ_IOPS_OPTION) {
+      throttle.set_read_iops(limit.get());
+    } else {
+      throttle.set_write_iops(limit.get());
+    }
+    throttled = true;
+  }
+
+  *options = strings::join(",", remaining);
+
+  if (!throttled) {
+    return None();
+  }
+  return throttle;
+}
+
+string throttleCgroup(const string& containerId)
+{
+  return path::join(DVDI_BLKIO_CGROUP_ROOT, containerId);
+}
+
+Try<string> throttledDevice(const string& mountpoint)
+{
+  struct stat s;
+  if (::stat(mountpoint.c_str(), &s) != 0) {
+    return ErrnoError("Failed to stat " + mountpoint);
+  }
+
+  const string device =
+    stringify(major(s.st_dev)) + ":" + stringify(minor(s.st_dev));
+
+  // Anonymous devices, as NFS and other network filesystems use.
+  if (major(s.st_dev) == 0) {
+    return Error(mountpoint + " is not on a block device");
+  }
+
+  // A partition's sysfs directory sits in the one of its disk.
+  const string sysfs = path::join("/sys/dev/block", device);
+  if (!os::exists(path::join(sysfs, "partition"))) {
+    return device;
+  }
+
+  Result<string> realpath = os::realpath(sysfs);
+  if (!realpath.isSome()) {
+    return Error("Failed to resolve " + sysfs);
+  }
+
+  Try<string> disk =
+    os::read(path::join(Path(realpath.get()).dirname(), "dev"));
+  if (disk.isError()) {
+    return Error("Failed to find the disk of partition " + device + ": " +
+                 disk.error());
+  }
+
+  return strings::trim(disk.get());
+}
+
+bool agentIsolatesBlkio()
+{
+  Option<string> isolation = os::getenv("MESOS_ISOLATION");
+
+  Try<string> cmdline = os::read("/proc/self/cmdline");
+  if (cmdline.isSome()) {
+    // The arguments are separated by NULs.
+    const string separator(1, '\0');
+    const vector<string> args = strings::split(cmdline.get(), separator);
+    for (size_t i = 0; i < args.size(); i++) {
+      if (strings::startsWith(args[i], "--isolation=")) {
+        isolation = args[i].substr(strlen("--isolation="));
+      } else if (args[i] == "--isolation" && i + 1 < args.size()) {
+        isolation = args[i + 1];
+      }
+    }
+  }
+
+  if (isolation.isNone()) {
+    return false;
+  }
+
+  foreach (const string& isolator,
+           strings::tokenize(isolation.get(), ",")) {
+    if (strings::trim(isolator) == MESOS_BLKIO_ISOLATOR) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Try<Nothing> applyThrottles(
+    const string& hierarchy,
+    const string& cgroup,
+    const hashmap<string, IoThrottle>& throttles)
+{
+  foreachpair (const string& device,
+               const IoThrottle& throttle,
+               throttles) {
+    // Writing a limit of 0 lifts it.
+    const vector<std::pair<string, uint64_t>> limits = {
+      {"blkio.throttle.read_bps_device", throttle.read_bps()},
+      {"blkio.throttle.write_bps_device", throttle.write_bps()},
+      {"blkio.throttle.read_iops_device", throttle.read_iops()},
+      {"blkio.throttle.write_iops_device", throttle.write_iops()},
+    };
+
+    foreach (const auto& limit, limits) {
+      Try<Nothing> write = cgroups::write(
+          hierarchy,
+          cgroup,
+          limit.first,
+          device + " " + stringify(limit.second));
+      if (write.isError()) {
+        return Error("Failed to set " + limit.first + " of " + device +
+                     ": " + write.error());
+      }
+    }
+  }
+
+  return Nothing();
+}
+
+} /* namespace slave */
+} /* namespace mesos */
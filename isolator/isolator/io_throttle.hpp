@@ -0,0 +1,79 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_IO_THROTTLE_HPP_
+#define SRC_IO_THROTTLE_HPP_
+
+#include <string>
+
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "interface.hpp"
+
+namespace mesos {
+namespace slave {
+
+// Throttle options of DVDI_VOLUME_OPTS, e.g.
+// DVDI_VOLUME_OPTS=size=5,read_bps=50MB,write_iops=200. They are taken
+// out of the options before the volume driver sees them.
+static constexpr char THROTTLE_READ_BPS_OPTION[]   = "read_bps";
+static constexpr char THROTTLE_WRITE_BPS_OPTION[]  = "write_bps";
+static constexpr char THROTTLE_READ_IOPS_OPTION[]  = "read_iops";
+static constexpr char THROTTLE_WRITE_IOPS_OPTION[] = "write_iops";
+
+// Throttled containers get a blkio cgroup of their own,
+// <blkio hierarchy>/dvdi/<containerid>.
+static constexpr char DVDI_BLKIO_CGROUP_ROOT[]    = "dvdi";
+
+// The Mesos isolator that also moves tasks into blkio cgroups.
+static constexpr char MESOS_BLKIO_ISOLATOR[]      = "cgroups/blkio";
+
+// Moves the throttle options out of a comma separated option list.
+// Returns none if the list has none, an error if one is malformed.
+// Rates in bytes take a unit, e.g. 50MB, or are plain numbers of bytes.
+Try<Option<IoThrottle>> extractThrottle(std::string* options);
+
+// The blkio cgroup of a throttled container.
+std::string throttleCgroup(const std::string& containerId);
+
+// "major:minor" of the whole disk holding the filesystem mounted at
+// `mountpoint`, the kernel only throttles whole disks. An error for
+// filesystems without a block device, e.g. NFS.
+Try<std::string> throttledDevice(const std::string& mountpoint);
+
+// Whether the agent runs the Mesos cgroups/blkio isolator, going by its
+// --isolation flag, or MESOS_ISOLATION if the flag is not on its
+// command line. Throttling would take tasks out of that isolator's
+// cgroups. Only a sanity check of io_throttling: flags read from a
+// file are not seen.
+bool agentIsolatesBlkio();
+
+// Sets the limits of the cgroup on each of the devices, keyed by
+// "major:minor". Limits left out of an IoThrottle are lifted.
+Try<Nothing> applyThrottles(
+    const std::string& hierarchy,
+    const std::string& cgroup,
+    const hashmap<std::string, IoThrottle>& throttles);
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_IO_THROTTLE_HPP_ */
@@ -0,0 +1,124 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <process/metrics/metrics.hpp>
+
+#include <stout/foreach.hpp>
+
+#include "metrics.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace slave {
+
+static string name(const string& volumedriver, const string& metric)
+{
+  return DVDI_METRICS_PREFIX + volumedriver + "/" + metric;
+}
+
+VolumeDriverMetrics::VolumeDriverMetrics(const string& volumedriver)
+  : mount(name(volumedriver, "mount_ms"), DVDI_METRICS_WINDOW),
+    unmount(name(volumedriver, "unmount_ms"), DVDI_METRICS_WINDOW),
+    mount_failures(name(volumedriver, "mount_failures")),
+    unmount_failures(name(volumedriver, "unmount_failures")),
+    coalesced_mounts(name(volumedriver, "coalesced_mounts")),
+    coalesced_unmounts(name(volumedriver, "coalesced_unmounts")),
+    mounted(0),
+    mounted_volumes(
+        name(volumedriver, "mounted_volumes"),
+        [this]() { return static_cast<double>(mounted.load()); }),
+    lingering(0),
+    lingering_volumes(
+        name(volumedriver, "lingering_volumes"),
+        [this]() { return static_cast<double>(lingering.load()); }),
+    reused_mounts(name(volumedriver, "reused_mounts")),
+    queued(0),
+    queued_operations(
+        name(volumedriver, "queued_operations"),
+        [this]() { return static_cast<double>(queued.load()); }),
+    queue_wait(name(volumedriver, "queue_wait_ms"), DVDI_METRICS_WINDOW)
+{
+  process::metrics::add(mount);
+  process::metrics::add(unmount);
+  process::metrics::add(mount_failures);
+  process::metrics::add(unmount_failures);
+  process::metrics::add(coalesced_mounts);
+  process::metrics::add(coalesced_unmounts);
+  process::metrics::add(mounted_volumes);
+  process::metrics::add(lingering_volumes);
+  process::metrics::add(reused_mounts);
+  process::metrics::add(queued_operations);
+  process::metrics::add(queue_wait);
+}
+
+VolumeDriverMetrics::~VolumeDriverMetrics()
+{
+  process::metrics::remove(mount);
+  process::metrics::remove(unmount);
+  process::metrics::remove(mount_failures);
+  process::metrics::remove(unmount_failures);
+  process::metrics::remove(coalesced_mounts);
+  process::metrics::remove(coalesced_unmounts);
+  process::metrics::remove(mounted_volumes);
+  process::metrics::remove(lingering_volumes);
+  process::metrics::remove(reused_mounts);
+  process::metrics::remove(queued_operations);
+  process::metrics::remove(queue_wait);
+}
+
+
+DvdiMetrics::DvdiMetrics()
+  : checkpoint(
+        string(DVDI_METRICS_PREFIX) + "checkpoint_ms", DVDI_METRICS_WINDOW),
+    checkpoint_failures(string(DVDI_METRICS_PREFIX) + "checkpoint_failures"),
+    recoverMs(0),
+    recover(
+        string(DVDI_METRICS_PREFIX) + "recover_ms",
+        [this]() { return recoverMs.load(); })
+{
+  process::metrics::add(checkpoint);
+  process::metrics::add(checkpoint_failures);
+  process::metrics::add(recover);
+}
+
+DvdiMetrics::~DvdiMetrics()
+{
+  process::metrics::remove(checkpoint);
+  process::metrics::remove(checkpoint_failures);
+  process::metrics::remove(recover);
+}
+
+VolumeDriverMetrics& DvdiMetrics::driver(const string& volumedriver)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (!drivers.contains(volumedriver)) {
+    drivers[volumedriver].reset(new VolumeDriverMetrics(volumedriver));
+  }
+
+  return *drivers[volumedriver];
+}
+
+void DvdiMetrics::recovered(const Duration& duration)
+{
+  recoverMs.store(duration.ms());
+}
+
+} /* namespace slave */
+} /* namespace mesos */
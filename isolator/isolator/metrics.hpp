@@ -0,0 +1,115 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_METRICS_HPP_
+#define SRC_METRICS_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include <process/owned.hpp>
+
+#include <process/metrics/counter.hpp>
+#include <process/metrics/gauge.hpp>
+#include <process/metrics/timer.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+
+namespace mesos {
+namespace slave {
+
+// Prefix of every metric of the isolator, e.g. "dvdi/rexray/mount_ms".
+static constexpr char DVDI_METRICS_PREFIX[]       = "dvdi/";
+
+// Window over which the timers keep samples for their percentiles.
+static const Duration DVDI_METRICS_WINDOW         = Hours(1);
+
+// Metrics of a single volume driver. The timers are published by the
+// Mesos metrics process with their percentiles, so the latency of a
+// driver can be read from the agent's /metrics/snapshot endpoint.
+struct VolumeDriverMetrics
+{
+  explicit VolumeDriverMetrics(const std::string& volumedriver);
+
+  ~VolumeDriverMetrics();
+
+  process::metrics::Timer<Milliseconds> mount;
+  process::metrics::Timer<Milliseconds> unmount;
+
+  process::metrics::Counter mount_failures;
+  process::metrics::Counter unmount_failures;
+
+  // Requests that joined a mount or unmount of the same volume
+  // already running rather than invoking dvdcli themselves.
+  process::metrics::Counter coalesced_mounts;
+  process::metrics::Counter coalesced_unmounts;
+
+  // Volumes of the driver currently used by containers on the agent.
+  std::atomic<size_t> mounted;
+  process::metrics::Gauge mounted_volumes;
+
+  // Volumes on the detach queue, and the mounts that took one of them
+  // over instead of invoking dvdcli.
+  std::atomic<size_t> lingering;
+  process::metrics::Gauge lingering_volumes;
+  process::metrics::Counter reused_mounts;
+
+  // Mounts and unmounts waiting for admission, and how long they
+  // waited, see admission_queue.hpp.
+  std::atomic<size_t> queued;
+  process::metrics::Gauge queued_operations;
+  process::metrics::Timer<Milliseconds> queue_wait;
+};
+
+
+// All metrics of the isolator. Per driver metrics are registered the
+// first time a driver is seen and stay registered until the isolator
+// is destroyed.
+class DvdiMetrics
+{
+public:
+  DvdiMetrics();
+
+  ~DvdiMetrics();
+
+  // Safe to call from any thread.
+  VolumeDriverMetrics& driver(const std::string& volumedriver);
+
+  // Time until a journal change is durable, including the group
+  // commit window.
+  process::metrics::Timer<Milliseconds> checkpoint;
+  process::metrics::Counter checkpoint_failures;
+
+  // recover() runs once per agent start, so only its last duration
+  // is kept.
+  void recovered(const Duration& duration);
+
+private:
+  std::atomic<double> recoverMs;
+  process::metrics::Gauge recover;
+
+  std::mutex mutex;
+  hashmap<std::string, process::Owned<VolumeDriverMetrics>> drivers;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_METRICS_HPP_ */
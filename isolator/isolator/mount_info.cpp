@@ -0,0 +1,226 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashset.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/strings.hpp>
+
+#include "mount_info.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace slave {
+
+// The kernel writes ' ', '\t', '\n' and '\\' in paths as \ooo.
+static string unescape(const string& field)
+{
+  string result;
+  result.reserve(field.size());
+
+  for (size_t i = 0; i < field.size(); i++) {
+    if (field[i] == '\\' && i + 3 < field.size() &&
+        field[i + 1] >= '0' && field[i + 1] <= '3' &&
+        field[i + 2] >= '0' && field[i + 2] <= '7' &&
+        field[i + 3] >= '0' && field[i + 3] <= '7') {
+      result += static_cast<char>(
+          (field[i + 1] - '0') * 64 +
+          (field[i + 2] - '0') * 8 +
+          (field[i + 3] - '0'));
+      i += 3;
+    } else {
+      result += field[i];
+    }
+  }
+
+  return result;
+}
+
+// Paths as the kernel lists them, without a trailing '/'.
+static string normalize(const string& path)
+{
+  if (path.size() > 1 && strings::endsWith(path, "/")) {
+    return strings::remove(path, "/", strings::SUFFIX);
+  }
+  return path;
+}
+
+Try<MountInfoEntry> parseMountInfo(const string& line)
+{
+  // id parent major:minor root target options [optional fields...] -
+  // type source super_options
+  const vector<string> fields = strings::tokenize(line, " ");
+
+  size_t separator = 6;
+  while (separator < fields.size() && fields[separator] != "-") {
+    separator++;
+  }
+  if (separator + 2 >= fields.size()) {
+    return Error("Malformed mountinfo line: " + line);
+  }
+
+  Try<int> id = numify<int>(fields[0]);
+  Try<int> parent = numify<int>(fields[1]);
+  if (id.isError() || parent.isError()) {
+    return Error("Malformed mount IDs in mountinfo line: " + line);
+  }
+
+  MountInfoEntry entry;
+  entry.id = id.get();
+  entry.parent = parent.get();
+  entry.device = fields[2];
+  entry.root = unescape(fields[3]);
+  entry.target = unescape(fields[4]);
+  entry.type = fields[separator + 1];
+  entry.source = unescape(fields[separator + 2]);
+
+  return entry;
+}
+
+
+MountInfoIndex::MountInfoIndex() {}
+
+MountInfoIndex::~MountInfoIndex()
+{
+  if (fd.isSome()) {
+    os::close(fd.get());
+  }
+}
+
+Try<bool> MountInfoIndex::refresh()
+{
+  if (fd.isNone()) {
+    Try<int> open = os::open(DVDI_MOUNTINFO_PATH, O_RDONLY | O_CLOEXEC);
+    if (open.isError()) {
+      return Error("Failed to open " + string(DVDI_MOUNTINFO_PATH) + ": " +
+                   open.error());
+    }
+    fd = open.get();
+  } else {
+    // Polling also acknowledges the change, the next poll only reports
+    // changes made after this one.
+    struct pollfd changed;
+    changed.fd = fd.get();
+    changed.events = POLLPRI;
+    changed.revents = 0;
+
+    const int ready = ::poll(&changed, 1, 0);
+    if (ready < 0) {
+      return ErrnoError("Failed to poll " + string(DVDI_MOUNTINFO_PATH));
+    }
+    if (ready == 0) {
+      return false;
+    }
+  }
+
+  if (::lseek(fd.get(), 0, SEEK_SET) < 0) {
+    return ErrnoError("Failed to rewind " + string(DVDI_MOUNTINFO_PATH));
+  }
+
+  string data;
+  char buffer[16384];
+  while (true) {
+    const ssize_t length = ::read(fd.get(), buffer, sizeof(buffer));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length < 0) {
+      return ErrnoError("Failed to read " + string(DVDI_MOUNTINFO_PATH));
+    }
+    if (length == 0) {
+      break;
+    }
+    data.append(buffer, length);
+  }
+
+  auto drop = [this](const MountInfoEntry& entry) {
+    if (mounts.contains(entry.target) && --mounts[entry.target] == 0) {
+      mounts.erase(entry.target);
+    }
+  };
+
+  hashset<int> seen;
+  foreach (const string& line, strings::tokenize(data, "\n")) {
+    Try<int> id = numify<int>(line.substr(0, line.find(' ')));
+    if (id.isError()) {
+      return Error("Malformed mountinfo line: " + line);
+    }
+    seen.insert(id.get());
+
+    if (byId.contains(id.get())) {
+      if (byId[id.get()].line == line) {
+        continue;
+      }
+      drop(byId[id.get()].entry);
+    }
+
+    Try<MountInfoEntry> entry = parseMountInfo(line);
+    if (entry.isError()) {
+      return Error(entry.error());
+    }
+
+    byId[id.get()] = Mount{line, entry.get()};
+    mounts[entry.get().target]++;
+  }
+
+  foreach (int id, byId.keys()) {
+    if (!seen.contains(id)) {
+      drop(byId[id].entry);
+      byId.erase(id);
+    }
+  }
+
+  return true;
+}
+
+bool MountInfoIndex::mounted(const string& path) const
+{
+  const string target = normalize(path);
+  if (mounts.contains(target)) {
+    return true;
+  }
+
+  // Everything is below the root filesystem.
+  const string parent = Path(target).dirname();
+  return parent != "/" && mounts.contains(parent);
+}
+
+vector<string> MountInfoIndex::under(const string& prefix) const
+{
+  const string parent = normalize(prefix) + "/";
+
+  vector<string> targets;
+  foreachkey (const string& target, mounts) {
+    if (strings::startsWith(target, parent)) {
+      targets.push_back(target);
+    }
+  }
+  return targets;
+}
+
+} /* namespace slave */
+} /* namespace mesos */
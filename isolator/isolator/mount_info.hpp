@@ -0,0 +1,98 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_MOUNT_INFO_HPP_
+#define SRC_MOUNT_INFO_HPP_
+
+#include <string>
+#include <vector>
+
+#include <stout/hashmap.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace slave {
+
+static constexpr char DVDI_MOUNTINFO_PATH[]       = "/proc/self/mountinfo";
+
+// A line of /proc/self/mountinfo, see proc(5).
+struct MountInfoEntry
+{
+  int id;
+  int parent;
+  std::string device;   // "major:minor"
+  std::string root;
+  std::string target;
+  std::string type;
+  std::string source;
+};
+
+// Parses a line of mountinfo, unescaping the octal escapes the kernel
+// uses for spaces and such in paths.
+Try<MountInfoEntry> parseMountInfo(const std::string& line);
+
+
+// The agent's mount table, keyed by mount target.
+//
+// The kernel flags mountinfo for poll(2) whenever the table changes,
+// so refresh() costs a poll of an open file while nothing changes, and
+// only lines of mounts not seen before are parsed when something does.
+// Not thread safe, the isolator only uses it from its actor.
+class MountInfoIndex
+{
+public:
+  MountInfoIndex();
+
+  ~MountInfoIndex();
+
+  // Brings the index up to date with the kernel's mount table.
+  Try<bool> refresh();
+
+  // Whether a filesystem is mounted at `path`, or at its parent: volume
+  // drivers such as REX-Ray hand out a directory at the root of the
+  // volume's filesystem. Both are looked up in the index as it was at
+  // the last refresh().
+  bool mounted(const std::string& path) const;
+
+  // Mount targets below `prefix`.
+  std::vector<std::string> under(const std::string& prefix) const;
+
+  size_t size() const { return mounts.size(); }
+
+private:
+  // Open from the first refresh() on, for poll(2).
+  Option<int> fd;
+
+  // Keyed by mount ID, which the kernel does not reuse while the mount
+  // exists; the line is kept to spot a mount ID reused since.
+  struct Mount
+  {
+    std::string line;
+    MountInfoEntry entry;
+  };
+  hashmap<int, Mount> byId;
+
+  // Mount targets, with how many mounts are stacked on each.
+  hashmap<std::string, size_t> mounts;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_MOUNT_INFO_HPP_ */
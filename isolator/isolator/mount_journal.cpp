@@ -0,0 +1,338 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <map>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include <process/delay.hpp>
+#include <process/id.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/protobuf.hpp>
+#include <stout/result.hpp>
+
+#include <slave/state.hpp>
+
+#include "mount_journal.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace slave {
+
+MountJournal::MountJournal(
+    const string& _directory,
+    size_t _compactionThreshold)
+  : directory(_directory),
+    snapshotPath(path::join(_directory, DVDI_SNAPSHOT_FILENAME)),
+    logPath(path::join(_directory, DVDI_LOG_FILENAME)),
+    compactionThreshold(_compactionThreshold),
+    appended(0) {}
+
+MountJournal::~MountJournal()
+{
+  if (logFd.isSome()) {
+    os::close(logFd.get());
+  }
+}
+
+MountJournalRecord MountJournal::added(const ExternalMount& mount)
+{
+  MountJournalRecord record;
+  record.set_type(MountJournalRecord::ADD);
+  record.mutable_mount()->CopyFrom(mount);
+  return record;
+}
+
+MountJournalRecord MountJournal::removed(const string& containerId)
+{
+  MountJournalRecord record;
+  record.set_type(MountJournalRecord::REMOVE);
+  record.set_containerid(containerId);
+  return record;
+}
+
+MountJournalRecord MountJournal::released(const ExternalMount& mount)
+{
+  MountJournalRecord record;
+  record.set_type(MountJournalRecord::RELEASE);
+  record.mutable_mount()->CopyFrom(mount);
+  return record;
+}
+
+void MountJournal::apply(const MountJournalRecord& record)
+{
+  switch (record.type()) {
+    case MountJournalRecord::ADD:
+    case MountJournalRecord::RELEASE: {
+      const ExternalMount& mount = record.mount();
+      const string key = mount.has_volume_key()
+        ? mount.volume_key()
+        : volumeKey(mount.volumedriver(), mount.volumename());
+      if (record.type() == MountJournalRecord::ADD) {
+        table[std::make_pair(mount.containerid(), key)] = mount;
+      } else {
+        table.erase(std::make_pair(mount.containerid(), key));
+      }
+      break;
+    }
+    case MountJournalRecord::REMOVE: {
+      const string& containerId = record.containerid();
+      auto it = table.lower_bound(std::make_pair(containerId, string()));
+      while (it != table.end() && it->first.first == containerId) {
+        it = table.erase(it);
+      }
+      break;
+    }
+  }
+}
+
+ExternalMountList MountJournal::snapshot() const
+{
+  ExternalMountList mounts;
+  foreach (const auto& entry, table) {
+    mounts.add_mount()->CopyFrom(entry.second);
+  }
+  return mounts;
+}
+
+Try<ExternalMountList> MountJournal::recover()
+{
+  table.clear();
+
+  if (os::exists(snapshotPath)) {
+    Result<ExternalMountList> snapshot =
+      ::protobuf::read<ExternalMountList>(snapshotPath);
+
+    if (snapshot.isError()) {
+      return Error("Failed to read " + snapshotPath + ": " + snapshot.error());
+    }
+
+    if (snapshot.isSome()) {
+      foreach (const ExternalMount& mount, snapshot.get().mount()) {
+        apply(added(mount));
+      }
+    }
+  }
+
+  size_t replayed = 0;
+  if (os::exists(logPath)) {
+    Try<int> fd = os::open(logPath, O_RDONLY | O_CLOEXEC);
+    if (fd.isError()) {
+      return Error("Failed to open " + logPath + ": " + fd.error());
+    }
+
+    while (true) {
+      // A record cut short by a crash ends the replay, it was never
+      // acknowledged to the containerizer.
+      Result<MountJournalRecord> record =
+        ::protobuf::read<MountJournalRecord>(fd.get(), true, true);
+
+      if (record.isNone()) {
+        break;
+      }
+
+      if (record.isError()) {
+        LOG(WARNING) << "Ignoring the remainder of " << logPath
+                     << " after " << replayed << " records: "
+                     << record.error();
+        break;
+      }
+
+      replayed++;
+      apply(record.get());
+    }
+
+    os::close(fd.get());
+  }
+
+  LOG(INFO) << "Recovered " << table.size() << " mounts from " << directory
+            << " after replaying " << replayed << " journal records";
+
+  return snapshot();
+}
+
+Try<Nothing> MountJournal::compact(const ExternalMountList& mounts)
+{
+  Try<Nothing> mkdir = os::mkdir(directory);
+  if (mkdir.isError()) {
+    return Error("Failed to create " + directory + ": " + mkdir.error());
+  }
+
+  // The snapshot is replaced atomically, the log is only emptied
+  // once the new snapshot is in place.
+  Try<Nothing> checkpoint =
+    mesos::internal::slave::state::checkpoint(snapshotPath, mounts);
+  if (checkpoint.isError()) {
+    return Error("Failed to write " + snapshotPath + ": " + checkpoint.error());
+  }
+
+  if (logFd.isSome()) {
+    os::close(logFd.get());
+    logFd = None();
+  }
+
+  if (os::exists(logPath)) {
+    Try<Nothing> rm = os::rm(logPath);
+    if (rm.isError()) {
+      return Error("Failed to truncate " + logPath + ": " + rm.error());
+    }
+  }
+
+  table.clear();
+  foreach (const ExternalMount& mount, mounts.mount()) {
+    apply(added(mount));
+  }
+
+  appended = 0;
+
+  return Nothing();
+}
+
+Try<Nothing> MountJournal::append(const vector<MountJournalRecord>& records)
+{
+  if (records.empty()) {
+    return Nothing();
+  }
+
+  if (logFd.isNone()) {
+    Try<Nothing> mkdir = os::mkdir(directory);
+    if (mkdir.isError()) {
+      return Error("Failed to create " + directory + ": " + mkdir.error());
+    }
+
+    Try<int> fd = os::open(
+        logPath,
+        O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+        S_IRUSR | S_IWUSR);
+
+    if (fd.isError()) {
+      return Error("Failed to open " + logPath + ": " + fd.error());
+    }
+
+    logFd = fd.get();
+  }
+
+  // A failed write is cut back off, so that later records are never
+  // appended behind a partial one.
+  const off_t end = ::lseek(logFd.get(), 0, SEEK_END);
+
+  foreach (const MountJournalRecord& record, records) {
+    Try<Nothing> write = ::protobuf::write(logFd.get(), record);
+    if (write.isError()) {
+      if (end >= 0 && ::ftruncate(logFd.get(), end) != 0) {
+        PLOG(ERROR) << "Failed to discard partial record in " << logPath;
+      }
+      return Error("Failed to append to " + logPath + ": " + write.error());
+    }
+  }
+
+  if (::fsync(logFd.get()) != 0) {
+    return ErrnoError("Failed to sync " + logPath);
+  }
+
+  appended += records.size();
+
+  foreach (const MountJournalRecord& record, records) {
+    apply(record);
+  }
+
+  if (appended >= compactionThreshold) {
+    // The records are durable in the log already, a failed
+    // compaction only means the log keeps growing for now.
+    Try<Nothing> compacted = compact(snapshot());
+    if (compacted.isError()) {
+      LOG(ERROR) << "Failed to compact the mount journal: "
+                 << compacted.error();
+    }
+  }
+
+  return Nothing();
+}
+
+
+MountJournalWriter::MountJournalWriter(
+    const process::Owned<MountJournal>& _journal,
+    const Duration& _window)
+  : ProcessBase(process::ID::generate("mount-journal-writer")),
+    journal(_journal),
+    window(_window) {}
+
+process::Future<Nothing> MountJournalWriter::commit(
+    const vector<MountJournalRecord>& records)
+{
+  if (committed.get() == NULL) {
+    committed.reset(new process::Promise<Nothing>());
+    process::delay(window, self(), &MountJournalWriter::flush);
+  }
+
+  batch.insert(batch.end(), records.begin(), records.end());
+
+  return committed->future();
+}
+
+process::Future<Nothing> MountJournalWriter::compact(
+    const ExternalMountList& mounts)
+{
+  if (committed.get() != NULL) {
+    flush();
+  }
+
+  Try<Nothing> compacted = journal->compact(mounts);
+  if (compacted.isError()) {
+    return process::Failure(compacted.error());
+  }
+
+  return Nothing();
+}
+
+void MountJournalWriter::flush()
+{
+  // Already done by compact() since the flush was scheduled.
+  if (committed.get() == NULL) {
+    return;
+  }
+
+  process::Owned<process::Promise<Nothing>> promise = committed;
+  committed.reset();
+
+  vector<MountJournalRecord> records;
+  records.swap(batch);
+
+  VLOG(1) << "Committing " << records.size() << " mount journal records";
+
+  Try<Nothing> append = journal->append(records);
+  if (append.isError()) {
+    promise->fail(append.error());
+    return;
+  }
+
+  promise->set(Nothing());
+}
+
+} /* namespace slave */
+} /* namespace mesos */
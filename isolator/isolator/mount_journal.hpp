@@ -0,0 +1,140 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_MOUNT_JOURNAL_HPP_
+#define SRC_MOUNT_JOURNAL_HPP_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <process/future.hpp>
+#include <process/owned.hpp>
+#include <process/process.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+#include "interface.hpp"
+
+namespace mesos {
+namespace slave {
+
+static constexpr char DVDI_JOURNAL_DIRNAME[]      = "journal";
+static constexpr char DVDI_SNAPSHOT_FILENAME[]    = "snapshot.pb";
+static constexpr char DVDI_LOG_FILENAME[]         = "log.pb";
+
+// Durable record of the isolator's mount table.
+//
+// Every change is appended to a log as a MountJournalRecord and synced,
+// so a container start or stop costs one small write no matter how many
+// mounts are tracked. The journal also keeps the resulting table in
+// memory; once enough records have accumulated, it writes the table
+// into a snapshot and the log starts over.
+//
+// Replaying a record twice leaves the table unchanged, so a crash
+// between writing a snapshot and truncating the log is harmless.
+class MountJournal
+{
+public:
+  MountJournal(const std::string& directory, size_t compactionThreshold);
+
+  virtual ~MountJournal();
+
+  // Record stating the mount is now used by mount.containerid().
+  static MountJournalRecord added(const ExternalMount& mount);
+
+  // Record stating the container no longer uses any mount.
+  static MountJournalRecord removed(const std::string& containerId);
+
+  // Record stating the mount is no longer used by mount.containerid(),
+  // the container's other mounts are left alone.
+  static MountJournalRecord released(const ExternalMount& mount);
+
+  // Rebuilds the mount table from the snapshot followed by the log.
+  // Returns an empty list if no journal exists yet.
+  Try<ExternalMountList> recover();
+
+  // Appends the records and syncs the log once for all of them.
+  Try<Nothing> append(const std::vector<MountJournalRecord>& records);
+
+  // Replaces the table and snapshot with the given mounts and
+  // empties the log.
+  Try<Nothing> compact(const ExternalMountList& mounts);
+
+private:
+  void apply(const MountJournalRecord& record);
+
+  ExternalMountList snapshot() const;
+
+  const std::string directory;
+  const std::string snapshotPath;
+  const std::string logPath;
+  const size_t compactionThreshold;
+
+  // Lazily opened for appending.
+  Option<int> logFd;
+
+  // Records appended since the last compaction.
+  size_t appended;
+
+  // Keyed by (containerid, volume key), the same pair identifies
+  // a mount in the isolator's infos.
+  std::map<std::pair<std::string, std::string>, ExternalMount> table;
+};
+
+
+// Group commit front end of a MountJournal.
+//
+// Records committed within `window` of the first pending one are
+// appended together with a single fsync. Each commit() future is only
+// satisfied once the sync containing its records has returned, so
+// callers keep the same durability as with one sync per change.
+class MountJournalWriter : public process::Process<MountJournalWriter>
+{
+public:
+  MountJournalWriter(
+      const process::Owned<MountJournal>& journal,
+      const Duration& window);
+
+  process::Future<Nothing> commit(
+      const std::vector<MountJournalRecord>& records);
+
+  // Flushes the pending records, then compacts the journal into the
+  // given mounts, see MountJournal::compact().
+  process::Future<Nothing> compact(const ExternalMountList& mounts);
+
+private:
+  void flush();
+
+  const process::Owned<MountJournal> journal;
+  const Duration window;
+
+  // Records waiting for the next flush and the promise of their commit,
+  // the promise is only set while a flush is scheduled.
+  std::vector<MountJournalRecord> batch;
+  process::Owned<process::Promise<Nothing>> committed;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_MOUNT_JOURNAL_HPP_ */
@@ -0,0 +1,108 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stout/foreach.hpp>
+
+#include "mount_table.hpp"
+
+using std::list;
+using std::string;
+using std::vector;
+
+using process::Owned;
+
+namespace mesos {
+namespace slave {
+
+bool MountTable::track(
+    const ContainerID& containerId,
+    const Owned<ExternalMount>& mount)
+{
+  infos.put(containerId, mount);
+
+  const string key = mountKey(*mount);
+  const bool added = !index.contains(key);
+  if (added) {
+    index[key] = MountRecord{mount, 0, hashset<ContainerID>()};
+  }
+
+  MountRecord& record = index[key];
+  record.refcount++;
+  record.containers.insert(containerId);
+
+  return added;
+}
+
+vector<Owned<ExternalMount>> MountTable::untrack(
+    const ContainerID& containerId)
+{
+  vector<Owned<ExternalMount>> released;
+
+  foreach (const Owned<ExternalMount>& mount, infos.get(containerId)) {
+    const string key = mountKey(*mount);
+    if (!index.contains(key)) {
+      continue;
+    }
+
+    MountRecord& record = index[key];
+    record.containers.erase(containerId);
+    if (--record.refcount == 0) {
+      released.push_back(mount);
+      index.erase(key);
+    }
+  }
+
+  infos.remove(containerId);
+
+  return released;
+}
+
+bool MountTable::contains(const ContainerID& containerId) const
+{
+  return infos.contains(containerId);
+}
+
+bool MountTable::inUse(const string& key) const
+{
+  return index.contains(key);
+}
+
+Option<string> MountTable::mountpoint(const string& key) const
+{
+  if (!index.contains(key)) {
+    return None();
+  }
+  return index.at(key).mount->mountpoint();
+}
+
+size_t MountTable::refcount(const string& key) const
+{
+  if (!index.contains(key)) {
+    return 0;
+  }
+  return index.at(key).refcount;
+}
+
+list<Owned<ExternalMount>> MountTable::get(
+    const ContainerID& containerId) const
+{
+  return infos.get(containerId);
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,110 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_MOUNT_TABLE_HPP_
+#define SRC_MOUNT_TABLE_HPP_
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <mesos/mesos.hpp>
+
+#include <process/owned.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/multihashmap.hpp>
+#include <stout/option.hpp>
+
+#include "interface.hpp"
+
+namespace mesos {
+namespace slave {
+
+// Identity of a volume, see volumeKey(). The key is cached in the mount
+// by Builder::build() (and by recover() for mounts read back from the
+// checkpoint), no lowercasing happens here.
+inline std::string mountKey(const ExternalMount& em)
+{
+  if (em.has_volume_key()) {
+    return em.volume_key();
+  }
+  return volumeKey(em.volumedriver(), em.volumename());
+}
+
+
+// The isolator's view of which container uses which volume.
+//
+// Mounts are kept per container, as the containerizer asks about
+// containers, and indexed per volume with a reference count, so the
+// in-use and last-user checks of prepare() and cleanup() cost the same
+// however many mounts the agent has.
+class MountTable
+{
+public:
+  using containermountmap =
+    multihashmap<ContainerID, process::Owned<ExternalMount>>;
+
+  struct MountRecord
+  {
+    // The first container's mount, its mountpoint is the shared one.
+    process::Owned<ExternalMount> mount;
+    size_t refcount;
+    hashset<ContainerID> containers;
+  };
+
+  // Records a mount of the container. Returns true if no container
+  // used the volume before.
+  bool track(
+      const ContainerID& containerId,
+      const process::Owned<ExternalMount>& mount);
+
+  // Removes all of the container's mounts, returns the mounts this
+  // container was the last user of.
+  std::vector<process::Owned<ExternalMount>> untrack(
+      const ContainerID& containerId);
+
+  bool contains(const ContainerID& containerId) const;
+
+  // Whether any container uses the volume with the given mountKey().
+  bool inUse(const std::string& key) const;
+
+  // Mountpoint shared by the users of the volume, if it is in use.
+  Option<std::string> mountpoint(const std::string& key) const;
+
+  size_t refcount(const std::string& key) const;
+
+  std::list<process::Owned<ExternalMount>> get(
+      const ContainerID& containerId) const;
+
+  // Every mount of every container, e.g. to checkpoint them.
+  const containermountmap& all() const { return infos; }
+
+  // Every volume in use, keyed by mountKey().
+  const hashmap<std::string, MountRecord>& volumes() const { return index; }
+
+private:
+  containermountmap infos;
+  hashmap<std::string, MountRecord> index;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_MOUNT_TABLE_HPP_ */
@@ -0,0 +1,277 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <sstream>
+#include <tuple>
+
+#include <glog/logging.h>
+
+#include <process/after.hpp>
+#include <process/collect.hpp>
+#include <process/io.hpp>
+#include <process/subprocess.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "volume_backend.hpp"
+
+using std::string;
+using std::vector;
+
+using process::await;
+using process::Failure;
+using process::Future;
+using process::Subprocess;
+using process::subprocess;
+
+namespace io = process::io;
+
+namespace mesos {
+namespace slave {
+
+// Runs dvdcli as an asynchronous child process, without an intermediate
+// shell, and returns its trimmed standard output. The returned future
+// fails if dvdcli can not be launched or exits with a non-zero status.
+static Future<string> dvdcli(const vector<string>& argv)
+{
+  Try<Subprocess> s = subprocess(
+      argv[0],
+      argv,
+      Subprocess::PATH("/dev/null"),
+      Subprocess::PIPE(),
+      Subprocess::PIPE());
+
+  if (s.isError()) {
+    return Failure("Failed to launch " + argv[0] + ": " + s.error());
+  }
+
+  // Capturing the Subprocess keeps its pipes open until both are drained.
+  const Subprocess child = s.get();
+  const pid_t pid = child.pid();
+
+  // A caller giving up on dvdcli, e.g. after a timeout, kills it so
+  // it can not complete behind the isolator's back.
+  Future<string> output = await(
+      child.status(),
+      io::read(child.out().get()),
+      io::read(child.err().get()))
+    .then([child](const std::tuple<
+        Future<Option<int>>,
+        Future<string>,
+        Future<string>>& t) -> Future<string> {
+      const Future<Option<int>>& status = std::get<0>(t);
+      const Future<string>& out = std::get<1>(t);
+      const Future<string>& err = std::get<2>(t);
+
+      if (!status.isReady() || status.get().isNone()) {
+        return Failure("Failed to reap the dvdcli process");
+      }
+
+      if (!WIFEXITED(status.get().get()) ||
+          WEXITSTATUS(status.get().get()) != 0) {
+        std::stringstream ss;
+        ss << "dvdcli exited with status " << status.get().get();
+        if (err.isReady() && !strings::trim(err.get()).empty()) {
+          ss << ": " << strings::trim(err.get());
+        }
+        return Failure(ss.str());
+      }
+
+      if (!out.isReady()) {
+        return Failure("Failed to read dvdcli output: " +
+                       (out.isFailed() ? out.failure() : "discarded"));
+      }
+
+      return strings::trim(out.get());
+    });
+
+  output.onDiscard([pid]() { ::kill(pid, SIGKILL); });
+
+  return output;
+}
+
+
+vector<string> formatOptions(const string& options)
+{
+  vector<string> args;
+  foreach (const string& option, strings::tokenize(options, ",")) {
+    args.push_back(VOL_OPTS_CMD_OPTION + option);
+  }
+  return args;
+}
+
+
+vector<string> DvdcliBackend::argv(
+    const ExternalMount& em,
+    const string& command)
+{
+  return {
+    em.dvdcli_path(),
+    command,
+    VOL_DRIVER_CMD_OPTION + em.volumedriver(),
+    VOL_NAME_CMD_OPTION + em.volumename()
+  };
+}
+
+Option<string> DvdcliBackend::unavailable(const ExternalMount& em) const
+{
+  if (!os::exists(em.dvdcli_path())) {
+    return "The DVDCLI binary doesn't exist at " + em.dvdcli_path();
+  }
+  return None();
+}
+
+string DvdcliBackend::describe(const ExternalMount& em) const
+{
+  return em.dvdcli_path();
+}
+
+Future<Nothing> DvdcliBackend::create(const ExternalMount& em) const
+{
+  vector<string> args = argv(em, DVDCLI_CREATE_CMD);
+  foreach (const string& option, formatOptions(em.options())) {
+    args.push_back(option);
+  }
+
+  LOG(INFO) << "Invoking " << strings::join(" ", args);
+
+  return dvdcli(args).then([]() { return Nothing(); });
+}
+
+Future<string> DvdcliBackend::mount(const ExternalMount& em) const
+{
+  vector<string> args = argv(em, DVDCLI_MOUNT_CMD);
+  foreach (const string& option, formatOptions(em.options())) {
+    args.push_back(option);
+  }
+
+  if (em.explicit_create()) {
+    args.push_back("--explicitCreate=true");
+  }
+
+  LOG(INFO) << "Invoking " << strings::join(" ", args);
+
+  return dvdcli(args);
+}
+
+Future<Nothing> DvdcliBackend::unmount(const ExternalMount& em) const
+{
+  const vector<string> args = argv(em, DVDCLI_UNMOUNT_CMD);
+
+  LOG(INFO) << "Invoking " << strings::join(" ", args);
+
+  return dvdcli(args).then([]() { return Nothing(); });
+}
+
+Future<string> DvdcliBackend::path(const ExternalMount& em) const
+{
+  const vector<string> args = argv(em, DVDCLI_PATH_CMD);
+
+  LOG(INFO) << "Invoking " << strings::join(" ", args);
+
+  return dvdcli(args);
+}
+
+
+FakeBackend::FakeBackend(
+    const string& _directory,
+    const Duration& _latency,
+    double _failureRate)
+  : directory(_directory),
+    latency(_latency),
+    failureRate(_failureRate),
+    random(std::random_device()()) {}
+
+Option<string> FakeBackend::unavailable(const ExternalMount& em) const
+{
+  return None();
+}
+
+string FakeBackend::describe(const ExternalMount& em) const
+{
+  return "fake backend in " + directory;
+}
+
+string FakeBackend::mountpoint(const ExternalMount& em) const
+{
+  return path::join(directory, em.volumedriver(), em.volumename());
+}
+
+Future<Nothing> FakeBackend::delay(const string& call) const
+{
+  bool fail = false;
+  if (failureRate > 0) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fail = std::uniform_real_distribution<double>(0, 1)(random) < failureRate;
+  }
+
+  Future<Nothing> waited = latency > Duration::zero()
+    ? process::after(latency)
+    : Future<Nothing>(Nothing());
+
+  if (!fail) {
+    return waited;
+  }
+
+  return waited.then([call]() -> Future<Nothing> {
+    return Failure("Injected failure of fake " + call);
+  });
+}
+
+Future<Nothing> FakeBackend::create(const ExternalMount& em) const
+{
+  return delay(DVDCLI_CREATE_CMD);
+}
+
+Future<string> FakeBackend::mount(const ExternalMount& em) const
+{
+  const string target = mountpoint(em);
+
+  return delay(DVDCLI_MOUNT_CMD)
+    .then([target]() -> Future<string> {
+      Try<Nothing> mkdir = os::mkdir(target);
+      if (mkdir.isError()) {
+        return Failure("Failed to create " + target + ": " + mkdir.error());
+      }
+      return target;
+    });
+}
+
+Future<Nothing> FakeBackend::unmount(const ExternalMount& em) const
+{
+  return delay(DVDCLI_UNMOUNT_CMD);
+}
+
+Future<string> FakeBackend::path(const ExternalMount& em) const
+{
+  const string target = mountpoint(em);
+
+  return delay(DVDCLI_PATH_CMD)
+    .then([target]() { return target; });
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,158 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_VOLUME_BACKEND_HPP_
+#define SRC_VOLUME_BACKEND_HPP_
+
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <process/future.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+
+#include "interface.hpp"
+
+namespace mesos {
+namespace slave {
+
+// Ways of mounting a volume, see ExternalMount.backend.
+static constexpr char DVDI_BACKEND_DVDCLI[]       = "dvdcli";
+static constexpr char DVDI_BACKEND_PLUGIN[]       = "plugin";
+static constexpr char DVDI_BACKEND_FAKE[]         = "fake";
+
+static constexpr char DVDCLI_CREATE_CMD[]         = "create";
+static constexpr char DVDCLI_MOUNT_CMD[]          = "mount";
+static constexpr char DVDCLI_UNMOUNT_CMD[]        = "unmount";
+static constexpr char DVDCLI_PATH_CMD[]           = "path";
+
+static constexpr char VOL_NAME_CMD_OPTION[]       = "--volumename=";
+static constexpr char VOL_DRIVER_CMD_OPTION[]     = "--volumedriver=";
+static constexpr char VOL_OPTS_CMD_OPTION[]       = "--volumeopts=";
+
+static constexpr char DEFAULT_FAKE_BACKEND_DIR[]  = "/tmp/mesos-dvdi-fake";
+
+// Converts a comma separated option list into dvdcli arguments.
+std::vector<std::string> formatOptions(const std::string& options);
+
+
+// Storage behind the isolator. Everything the isolator asks of the
+// volume driver goes through one of these, chosen for each volume by
+// ExternalMount.backend.
+//
+// All calls are asynchronous and may be made from any thread.
+class VolumeBackend
+{
+public:
+  virtual ~VolumeBackend() {}
+
+  // Returns why the backend can not serve the volume at all, e.g. its
+  // binary or socket is missing. Checked before every other call.
+  virtual Option<std::string> unavailable(const ExternalMount& em) const = 0;
+
+  // What serves the volume, for logging.
+  virtual std::string describe(const ExternalMount& em) const = 0;
+
+  virtual process::Future<Nothing> create(const ExternalMount& em) const = 0;
+
+  // Creates the volume if needed and mounts it on the agent, the
+  // future holds the non-empty mountpoint.
+  virtual process::Future<std::string> mount(const ExternalMount& em) const = 0;
+
+  virtual process::Future<Nothing> unmount(const ExternalMount& em) const = 0;
+
+  // Mountpoint of a mounted volume.
+  virtual process::Future<std::string> path(const ExternalMount& em) const = 0;
+
+  // Whether mount() leaves a filesystem mounted at the mountpoint, for
+  // the isolator to find in the agent's mount table.
+  virtual bool mountsFilesystem() const { return true; }
+};
+
+
+// Runs the dvdcli binary named by ExternalMount.dvdcli_path.
+class DvdcliBackend : public VolumeBackend
+{
+public:
+  virtual Option<std::string> unavailable(const ExternalMount& em) const;
+
+  virtual std::string describe(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> create(const ExternalMount& em) const;
+
+  virtual process::Future<std::string> mount(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> unmount(const ExternalMount& em) const;
+
+  virtual process::Future<std::string> path(const ExternalMount& em) const;
+
+private:
+  static std::vector<std::string> argv(
+      const ExternalMount& em,
+      const std::string& command);
+};
+
+
+// Stands in for real storage: after `latency` a mount only creates
+// <directory>/<volumedriver>/<volumename>, and each call fails with
+// probability `failureRate`. Lets the isolator's own overhead be
+// measured, and load tested, on any agent.
+class FakeBackend : public VolumeBackend
+{
+public:
+  FakeBackend(
+      const std::string& directory,
+      const Duration& latency,
+      double failureRate);
+
+  virtual Option<std::string> unavailable(const ExternalMount& em) const;
+
+  virtual std::string describe(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> create(const ExternalMount& em) const;
+
+  virtual process::Future<std::string> mount(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> unmount(const ExternalMount& em) const;
+
+  virtual process::Future<std::string> path(const ExternalMount& em) const;
+
+  virtual bool mountsFilesystem() const { return false; }
+
+private:
+  // Waits out the latency, then fails as often as configured.
+  process::Future<Nothing> delay(const std::string& call) const;
+
+  std::string mountpoint(const ExternalMount& em) const;
+
+  const std::string directory;
+  const Duration latency;
+  const double failureRate;
+
+  mutable std::mutex mutex;
+  mutable std::mt19937 random;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_VOLUME_BACKEND_HPP_ */
@@ -0,0 +1,269 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <sstream>
+#include <vector>
+
+#include <process/io.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/result.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+#include <stout/try.hpp>
+
+#include "volume_plugin.hpp"
+
+using std::string;
+using std::vector;
+
+using process::Failure;
+using process::Future;
+
+namespace mesos {
+namespace slave {
+
+static constexpr char PLUGIN_CONTENT_TYPE[] =
+  "application/vnd.docker.plugins.v1.2+json";
+
+// Converts a comma separated key=value option list into plugin options.
+static JSON::Object formatPluginOptions(const string& options)
+{
+  JSON::Object opts;
+  foreach (const string& option, strings::tokenize(options, ",")) {
+    const size_t separator = option.find('=');
+    if (separator == string::npos) {
+      opts.values[option] = JSON::String("");
+    } else {
+      opts.values[option.substr(0, separator)] =
+        JSON::String(option.substr(separator + 1));
+    }
+  }
+  return opts;
+}
+
+// Returns a non-blocking socket connected to the plugin. A Unix domain
+// socket connects at once or not at all, EAGAIN means the plugin's
+// backlog is full.
+static Try<int> connect(const string& path)
+{
+  struct sockaddr_un address;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return Error("Plugin socket path " + path + " is too long");
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+  const int fd =
+    ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return ErrnoError("Failed to create a socket for " + path);
+  }
+
+  if (::connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+    ErrnoError error("Failed to connect to " + path);
+    os::close(fd);
+    return error;
+  }
+
+  return fd;
+}
+
+// Extracts the JSON body of an HTTP response, failing on an error
+// status or an "Err" reported by the plugin.
+static Try<JSON::Object> parse(const string& response)
+{
+  const size_t headersEnd = response.find("\r\n\r\n");
+  if (headersEnd == string::npos) {
+    return Error("Truncated response from plugin");
+  }
+
+  const vector<string> status =
+    strings::tokenize(response.substr(0, response.find("\r\n")), " ");
+  if (status.size() < 2 || !strings::startsWith(status[0], "HTTP/")) {
+    return Error("Malformed status line in response from plugin");
+  }
+
+  const string body = response.substr(headersEnd + 4);
+
+  Try<JSON::Object> object = JSON::parse<JSON::Object>(body);
+  if (object.isError()) {
+    return Error("Plugin returned status " + status[1] + " and a body that " +
+                 "is not a JSON object: " + strings::trim(body));
+  }
+
+  Result<JSON::String> err = object.get().find<JSON::String>("Err");
+  if (err.isSome() && !err.get().value.empty()) {
+    return Error(err.get().value);
+  }
+
+  if (status[1] != "200") {
+    return Error("Plugin returned status " + status[1]);
+  }
+
+  return object.get();
+}
+
+
+VolumePluginClient::VolumePluginClient(const string& _socketDir)
+  : socketDir(_socketDir) {}
+
+string VolumePluginClient::socket(const ExternalMount& em) const
+{
+  return path::join(socketDir, em.volumedriver() + ".sock");
+}
+
+Option<string> VolumePluginClient::unavailable(const ExternalMount& em) const
+{
+  if (!os::exists(socket(em))) {
+    return "The volume plugin socket doesn't exist at " + socket(em);
+  }
+  return None();
+}
+
+string VolumePluginClient::describe(const ExternalMount& em) const
+{
+  return socket(em);
+}
+
+Future<JSON::Object> VolumePluginClient::call(
+    const ExternalMount& em,
+    const string& method,
+    const JSON::Object& request) const
+{
+  const string path = socket(em);
+  const string body = stringify(request);
+
+  std::ostringstream message;
+  message << "POST /VolumeDriver." << method << " HTTP/1.0\r\n"
+          << "Host: " << em.volumedriver() << "\r\n"
+          << "Accept: " << PLUGIN_CONTENT_TYPE << "\r\n"
+          << "Content-Type: " << PLUGIN_CONTENT_TYPE << "\r\n"
+          << "Content-Length: " << body.size() << "\r\n"
+          << "\r\n"
+          << body;
+
+  Try<int> fd = connect(path);
+  if (fd.isError()) {
+    return Failure(fd.error());
+  }
+
+  const int s = fd.get();
+
+  return process::io::write(s, message.str())
+    .then([s]() { return process::io::read(s); })
+    .onAny([s]() { os::close(s); })
+    .then([path, method](const string& response) -> Future<JSON::Object> {
+      Try<JSON::Object> object = parse(response);
+      if (object.isError()) {
+        return Failure("VolumeDriver." + method + " on " + path +
+                       " failed: " + object.error());
+      }
+      return object.get();
+    });
+}
+
+Future<Nothing> VolumePluginClient::create(const ExternalMount& em) const
+{
+  JSON::Object request;
+  request.values["Name"] = JSON::String(em.volumename());
+  request.values["Opts"] = formatPluginOptions(em.options());
+
+  return call(em, "Create", request)
+    .then([]() { return Nothing(); });
+}
+
+Future<string> VolumePluginClient::mount(const ExternalMount& em) const
+{
+  Future<Nothing> created = Nothing();
+  if (em.explicit_create() || !em.options().empty()) {
+    created = create(em);
+  }
+
+  JSON::Object request;
+  request.values["Name"] = JSON::String(em.volumename());
+  request.values["ID"] = JSON::String(DVDI_PLUGIN_MOUNT_ID);
+
+  const VolumePluginClient client = *this;
+
+  return created
+    .then([client, em, request]() {
+      return client.call(em, "Mount", request);
+    })
+    .then([](const JSON::Object& response) -> Future<string> {
+      Result<JSON::String> mountpoint =
+        response.find<JSON::String>("Mountpoint");
+      if (!mountpoint.isSome() || mountpoint.get().value.empty()) {
+        return Failure("Plugin returned an empty mountpoint");
+      }
+      return mountpoint.get().value;
+    });
+}
+
+Future<Nothing> VolumePluginClient::unmount(const ExternalMount& em) const
+{
+  JSON::Object request;
+  request.values["Name"] = JSON::String(em.volumename());
+  request.values["ID"] = JSON::String(DVDI_PLUGIN_MOUNT_ID);
+
+  return call(em, "Unmount", request)
+    .then([]() { return Nothing(); });
+}
+
+Future<string> VolumePluginClient::path(const ExternalMount& em) const
+{
+  JSON::Object request;
+  request.values["Name"] = JSON::String(em.volumename());
+
+  return call(em, "Path", request)
+    .then([](const JSON::Object& response) -> Future<string> {
+      Result<JSON::String> mountpoint =
+        response.find<JSON::String>("Mountpoint");
+      if (!mountpoint.isSome()) {
+        return Failure("Plugin returned no mountpoint");
+      }
+      return mountpoint.get().value;
+    });
+}
+
+Future<JSON::Object> VolumePluginClient::get(const ExternalMount& em) const
+{
+  JSON::Object request;
+  request.values["Name"] = JSON::String(em.volumename());
+
+  return call(em, "Get", request)
+    .then([](const JSON::Object& response) -> Future<JSON::Object> {
+      Result<JSON::Object> volume = response.find<JSON::Object>("Volume");
+      if (!volume.isSome()) {
+        return Failure("Plugin returned no volume");
+      }
+      return volume.get();
+    });
+}
+
+} /* namespace slave */
+} /* namespace mesos */
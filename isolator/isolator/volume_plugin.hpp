@@ -0,0 +1,87 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_VOLUME_PLUGIN_HPP_
+#define SRC_VOLUME_PLUGIN_HPP_
+
+#include <string>
+
+#include <process/future.hpp>
+
+#include <stout/json.hpp>
+#include <stout/nothing.hpp>
+
+#include "interface.hpp"
+#include "volume_backend.hpp"
+
+namespace mesos {
+namespace slave {
+
+static constexpr char DEFAULT_PLUGIN_SOCKET_DIR[]  = "/run/docker/plugins";
+
+// Passed as the ID of every mount and unmount request. The isolator
+// mounts a volume once however many containers use it, so the plugin
+// only ever needs to track a single user.
+static constexpr char DVDI_PLUGIN_MOUNT_ID[]       = "mesos-dvdi";
+
+// Client of the Docker volume plugin protocol, spoken directly to
+// <socketDir>/<volumedriver>.sock. This is what dvdcli does on our
+// behalf, minus starting a process for every call.
+//
+// Requests are sent as HTTP/1.0, so the plugin closes the connection
+// after its response and never chunks the body. All I/O is done by
+// libprocess, no call blocks the calling thread.
+class VolumePluginClient : public VolumeBackend
+{
+public:
+  explicit VolumePluginClient(const std::string& socketDir);
+
+  // Path of the socket serving the volume's driver.
+  std::string socket(const ExternalMount& em) const;
+
+  virtual Option<std::string> unavailable(const ExternalMount& em) const;
+
+  virtual std::string describe(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> create(const ExternalMount& em) const;
+
+  // Creates the volume if explicitly asked to or given options, as
+  // dvdcli does, then mounts it. The future holds the mountpoint.
+  virtual process::Future<std::string> mount(const ExternalMount& em) const;
+
+  virtual process::Future<Nothing> unmount(const ExternalMount& em) const;
+
+  virtual process::Future<std::string> path(const ExternalMount& em) const;
+
+  process::Future<JSON::Object> get(const ExternalMount& em) const;
+
+private:
+  // POSTs the request to /VolumeDriver.<method> and returns the
+  // response, failed if the plugin reports an "Err".
+  process::Future<JSON::Object> call(
+      const ExternalMount& em,
+      const std::string& method,
+      const JSON::Object& request) const;
+
+  const std::string socketDir;
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_VOLUME_PLUGIN_HPP_ */
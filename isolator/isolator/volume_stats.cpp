@@ -0,0 +1,152 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+#include <process/id.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/numify.hpp>
+#include <stout/os.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "volume_stats.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace slave {
+
+static string deviceKey(dev_t device)
+{
+  return stringify(major(device)) + ":" + stringify(minor(device));
+}
+
+Try<hashmap<string, DiskStats>> parseDiskStats(const string& data)
+{
+  hashmap<string, DiskStats> disks;
+
+  foreach (const string& line, strings::tokenize(data, "\n")) {
+    // major minor name reads reads_merged sectors_read ms_reading
+    // writes writes_merged sectors_written ..., see the kernel's
+    // Documentation/iostats.txt.
+    const vector<string> fields = strings::tokenize(line, " ");
+    if (fields.size() < 10) {
+      return Error("Unexpected line in diskstats: " + line);
+    }
+
+    Try<uint32_t> deviceMajor = numify<uint32_t>(fields[0]);
+    Try<uint32_t> deviceMinor = numify<uint32_t>(fields[1]);
+    Try<uint64_t> reads = numify<uint64_t>(fields[3]);
+    Try<uint64_t> sectorsRead = numify<uint64_t>(fields[5]);
+    Try<uint64_t> writes = numify<uint64_t>(fields[7]);
+    Try<uint64_t> sectorsWritten = numify<uint64_t>(fields[9]);
+    if (deviceMajor.isError() || deviceMinor.isError() ||
+        reads.isError() || sectorsRead.isError() ||
+        writes.isError() || sectorsWritten.isError()) {
+      return Error("Unexpected counters in diskstats: " + line);
+    }
+
+    DiskStats disk;
+    disk.deviceMajor = deviceMajor.get();
+    disk.deviceMinor = deviceMinor.get();
+    disk.reads = reads.get();
+    disk.readBytes = sectorsRead.get() * DISKSTATS_SECTOR_SIZE;
+    disk.writes = writes.get();
+    disk.writeBytes = sectorsWritten.get() * DISKSTATS_SECTOR_SIZE;
+
+    disks[fields[0] + ":" + fields[1]] = disk;
+  }
+
+  return disks;
+}
+
+Try<VolumeStats> sampleVolume(
+    const string& mountpoint,
+    const hashmap<string, DiskStats>& disks)
+{
+  struct statvfs fs;
+  if (::statvfs(mountpoint.c_str(), &fs) != 0) {
+    return ErrnoError("Failed to statvfs " + mountpoint);
+  }
+
+  struct stat s;
+  if (::stat(mountpoint.c_str(), &s) != 0) {
+    return ErrnoError("Failed to stat " + mountpoint);
+  }
+
+  VolumeStats stats;
+  stats.capacityBytes = static_cast<uint64_t>(fs.f_blocks) * fs.f_frsize;
+  stats.usedBytes =
+    static_cast<uint64_t>(fs.f_blocks - fs.f_bfree) * fs.f_frsize;
+  stats.disk = disks.get(deviceKey(s.st_dev));
+  stats.sampledAt = process::Clock::now().secs();
+
+  return stats;
+}
+
+
+VolumeStatsSampler::VolumeStatsSampler()
+  : ProcessBase(process::ID::generate("dvdi-volume-stats")) {}
+
+hashmap<string, VolumeStats> VolumeStatsSampler::sample(
+    const hashset<string>& mountpoints)
+{
+  hashmap<string, VolumeStats> sampled;
+
+  // Read once for all volumes, a volume without counters is still
+  // worth its statvfs.
+  hashmap<string, DiskStats> disks;
+  Try<string> data = os::read(DVDI_DISKSTATS_PATH);
+  if (data.isError()) {
+    LOG(WARNING) << "Failed to read " << DVDI_DISKSTATS_PATH << ": "
+                 << data.error();
+  } else {
+    Try<hashmap<string, DiskStats>> parsed = parseDiskStats(data.get());
+    if (parsed.isError()) {
+      LOG(WARNING) << "Failed to parse " << DVDI_DISKSTATS_PATH << ": "
+                   << parsed.error();
+    } else {
+      disks = parsed.get();
+    }
+  }
+
+  foreach (const string& mountpoint, mountpoints) {
+    Try<VolumeStats> stats = sampleVolume(mountpoint, disks);
+    if (stats.isError()) {
+      VLOG(1) << "Failed to sample volume usage: " << stats.error();
+      continue;
+    }
+    sampled[mountpoint] = stats.get();
+  }
+
+  return sampled;
+}
+
+} /* namespace slave */
+} /* namespace mesos */
@@ -0,0 +1,98 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_VOLUME_STATS_HPP_
+#define SRC_VOLUME_STATS_HPP_
+
+#include <stdint.h>
+
+#include <string>
+
+#include <process/process.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/option.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace slave {
+
+static constexpr char DVDI_DISKSTATS_PATH[]       = "/proc/diskstats";
+
+// /proc/diskstats counts in 512 byte sectors, whatever the device's
+// actual sector size.
+static constexpr uint64_t DISKSTATS_SECTOR_SIZE   = 512;
+
+// I/O counters of a block device since it appeared, from /proc/diskstats.
+struct DiskStats
+{
+  uint32_t deviceMajor;
+  uint32_t deviceMinor;
+  uint64_t reads;
+  uint64_t readBytes;
+  uint64_t writes;
+  uint64_t writeBytes;
+};
+
+// Usage of a mounted volume at the time it was sampled.
+struct VolumeStats
+{
+  // Size and bytes in use of the filesystem, from statvfs(3).
+  uint64_t capacityBytes;
+  uint64_t usedBytes;
+
+  // Counters of the block device backing the filesystem, none for
+  // filesystems without one, e.g. NFS.
+  Option<DiskStats> disk;
+
+  // Seconds since the epoch.
+  double sampledAt;
+};
+
+// Parses the contents of /proc/diskstats, keyed by "major:minor".
+Try<hashmap<std::string, DiskStats>> parseDiskStats(const std::string& data);
+
+// Samples the volume mounted at `mountpoint`, looking its device up in
+// `disks`. Blocks for as long as the filesystem takes to answer.
+Try<VolumeStats> sampleVolume(
+    const std::string& mountpoint,
+    const hashmap<std::string, DiskStats>& disks);
+
+
+// Samples volumes on behalf of the isolator.
+//
+// statvfs(3) of a volume whose storage went away can block for minutes,
+// so the isolator never samples in its own actor: usage() answers from
+// the last sample, and a sample still running when the next one is due
+// is left to finish.
+class VolumeStatsSampler : public process::Process<VolumeStatsSampler>
+{
+public:
+  VolumeStatsSampler();
+
+  // Keyed by mountpoint. Volumes that could not be sampled are left
+  // out.
+  hashmap<std::string, VolumeStats> sample(
+      const hashset<std::string>& mountpoints);
+};
+
+} /* namespace slave */
+} /* namespace mesos */
+
+#endif /* SRC_VOLUME_STATS_HPP_ */